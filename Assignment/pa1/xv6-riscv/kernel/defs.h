@@ -2,6 +2,7 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct memstat;
 struct pipe;
 struct proc;
 struct spinlock;
@@ -60,6 +61,8 @@ void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
 int             freepagespace(void);
+void            memcount(int, int);
+void            memstat_read(struct memstat*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -78,6 +81,16 @@ int             printf(char*, ...) __attribute__ ((format (printf, 1, 2)));
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prio.c
+void            rqinit(void);
+int             timeslice(int);
+void            rq_enqueue(struct proc*, int);
+void            rq_requeue(struct proc*);
+void            rq_expire(struct proc*);
+void            rq_wake(struct proc*);
+struct proc*    rq_pick(void);
+int             rq_tick(struct proc*);
+
 // proc.c
 int             cpuid(void);
 void            kexit(int);
@@ -12,4 +12,10 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define NPRIO        40    // scheduling priorities, one per nice value
+#define MAXSLICE     5     // time slice at nice 0 (ticks); nice 39 gets 1
+#define MAXSLEEPAVG  10    // sleep average (ticks) that earns the full bonus
+#define MAXBONUS     10    // priority levels between the most and least interactive
+#define INTERACTIVE_BONUS 3 // bonus from which a process is interactive
+#define STARVELIMIT  20    // ticks interactive processes may hold off expired ones
 
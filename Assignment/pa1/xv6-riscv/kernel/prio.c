@@ -0,0 +1,262 @@
+// O(1) priority run queue.
+//
+// RUNNABLE processes wait in one FIFO list per priority (0 is
+// the highest, NPRIO-1 the lowest), and a bitmap of the
+// non-empty lists lets the scheduler find the highest priority
+// with a find-first-set instead of a scan of proc[].
+//
+// A process's priority is its nice value, less a bonus of up to
+// MAXBONUS/2 levels for sleeping most of the time (interactive)
+// or plus up to as much for hogging the CPU. Its time slice, in
+// ticks, depends on nice alone.
+//
+// There are two priority arrays. Processes run from the active
+// one; one that uses up its slice goes to the expired one, so
+// that lower priorities get to run too, and when the active
+// array empties the two swap. An interactive process goes back
+// to the active array instead, unless the expired processes
+// have been waiting STARVELIMIT ticks.
+//
+// One queue serves all CPUs. rq.lock protects it and is taken
+// after p->lock.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct prioarray {
+  int nr_running;             // number of queued processes.
+  uint64 bitmap;              // bit i set if head[i] is non-empty.
+  struct proc *head[NPRIO];   // first and last queued process of each priority.
+  struct proc *tail[NPRIO];
+};
+
+static struct {
+  struct spinlock lock;
+  struct prioarray arrays[2];
+  struct prioarray *active;   // where the scheduler picks from.
+  struct prioarray *expired;  // processes that used up their slice.
+  uint expired_since;         // ticks when expired last became non-empty.
+} rq;
+
+void
+rqinit(void)
+{
+  initlock(&rq.lock, "runqueue");
+  rq.active = &rq.arrays[0];
+  rq.expired = &rq.arrays[1];
+}
+
+// index of the lowest set bit of x, which must be non-zero.
+// the kernel has no libgcc for __builtin_ctzl, so halve the
+// search instead: six steps for 64 bits.
+static int
+ffs64(uint64 x)
+{
+  int n = 0;
+
+  if((x & 0xffffffff) == 0){ n += 32; x >>= 32; }
+  if((x & 0xffff) == 0){ n += 16; x >>= 16; }
+  if((x & 0xff) == 0){ n += 8; x >>= 8; }
+  if((x & 0xf) == 0){ n += 4; x >>= 4; }
+  if((x & 0x3) == 0){ n += 2; x >>= 2; }
+  if((x & 0x1) == 0){ n += 1; }
+  return n;
+}
+
+// the sleep bonus, -MAXBONUS/2 to MAXBONUS/2.
+static int
+bonus(struct proc *p)
+{
+  return p->sleepavg * MAXBONUS / MAXSLEEPAVG - MAXBONUS / 2;
+}
+
+// p's priority: nice, adjusted for how interactive it is.
+static int
+effective_prio(struct proc *p)
+{
+  int prio = p->nice - bonus(p);
+
+  if(prio < 0)
+    prio = 0;
+  if(prio > NPRIO - 1)
+    prio = NPRIO - 1;
+  return prio;
+}
+
+// ticks a process of the given nice runs before it expires:
+// MAXSLICE at nice 0 down to 1 at nice 39.
+int
+timeslice(int nice)
+{
+  return 1 + (NPRIO - 1 - nice) * (MAXSLICE - 1) / (NPRIO - 1);
+}
+
+// Insert p at the tail of its priority's list, or at the head
+// if it was preempted and should keep its place.
+static void
+array_enqueue(struct prioarray *a, struct proc *p, int head)
+{
+  int prio = p->prio;
+
+  if(a->head[prio] == 0){
+    p->rq_prev = p->rq_next = 0;
+    a->head[prio] = a->tail[prio] = p;
+    a->bitmap |= 1UL << prio;
+  } else if(head){
+    p->rq_prev = 0;
+    p->rq_next = a->head[prio];
+    a->head[prio]->rq_prev = p;
+    a->head[prio] = p;
+  } else {
+    p->rq_next = 0;
+    p->rq_prev = a->tail[prio];
+    a->tail[prio]->rq_next = p;
+    a->tail[prio] = p;
+  }
+  p->rq_array = a;
+  a->nr_running++;
+}
+
+static void
+array_dequeue(struct prioarray *a, struct proc *p)
+{
+  int prio = p->prio;
+
+  if(p->rq_prev)
+    p->rq_prev->rq_next = p->rq_next;
+  else
+    a->head[prio] = p->rq_next;
+  if(p->rq_next)
+    p->rq_next->rq_prev = p->rq_prev;
+  else
+    a->tail[prio] = p->rq_prev;
+  if(a->head[prio] == 0)
+    a->bitmap &= ~(1UL << prio);
+
+  p->rq_prev = p->rq_next = 0;
+  p->rq_array = 0;
+  a->nr_running--;
+}
+
+// Queue p, which has just become RUNNABLE, in the active array.
+// head is set if p was preempted with slice left, so that it
+// runs again before others of its priority.
+// Caller must hold p->lock.
+void
+rq_enqueue(struct proc *p, int head)
+{
+  if(p->rq_array)
+    panic("rq_enqueue");
+  acquire(&rq.lock);
+  p->prio = effective_prio(p);
+  array_enqueue(rq.active, p, head);
+  release(&rq.lock);
+}
+
+// Move p, if it is queued, to the list its priority now
+// calls for, after its nice value changed.
+// Caller must hold p->lock.
+void
+rq_requeue(struct proc *p)
+{
+  struct prioarray *a;
+
+  acquire(&rq.lock);
+  if((a = p->rq_array) != 0){
+    array_dequeue(a, p);
+    p->prio = effective_prio(p);
+    array_enqueue(a, p, 0);
+  }
+  release(&rq.lock);
+}
+
+// Queue p, which has used up its time slice, with a new one.
+// Caller must hold p->lock.
+void
+rq_expire(struct proc *p)
+{
+  int interactive;
+
+  if(p->rq_array)
+    panic("rq_expire");
+  p->slice = timeslice(p->nice);
+  interactive = bonus(p) >= INTERACTIVE_BONUS;
+
+  acquire(&rq.lock);
+  p->prio = effective_prio(p);
+  if(interactive &&
+     (rq.expired->nr_running == 0 || ticks - rq.expired_since < STARVELIMIT)){
+    array_enqueue(rq.active, p, 0);
+  } else {
+    if(rq.expired->nr_running == 0)
+      rq.expired_since = ticks;
+    array_enqueue(rq.expired, p, 0);
+  }
+  release(&rq.lock);
+}
+
+// p, SLEEPING since p->sleepstart, has been woken: credit it
+// for the sleep and queue it.
+// Caller must hold p->lock.
+void
+rq_wake(struct proc *p)
+{
+  uint slept = ticks - p->sleepstart;
+
+  if(slept > MAXSLEEPAVG)
+    slept = MAXSLEEPAVG;
+  p->sleepavg += slept;
+  if(p->sleepavg > MAXSLEEPAVG)
+    p->sleepavg = MAXSLEEPAVG;
+  rq_enqueue(p, 0);
+}
+
+// Take the first process of the highest priority off the
+// queue, swapping the arrays if the active one is empty.
+// Returns 0 if nothing is RUNNABLE.
+struct proc*
+rq_pick(void)
+{
+  struct prioarray *a;
+  struct proc *p = 0;
+
+  acquire(&rq.lock);
+  if(rq.active->nr_running == 0){
+    a = rq.active;
+    rq.active = rq.expired;
+    rq.expired = a;
+  }
+  a = rq.active;
+  if(a->bitmap){
+    p = a->head[ffs64(a->bitmap)];
+    array_dequeue(a, p);
+  }
+  release(&rq.lock);
+  return p;
+}
+
+// Charge the running process p for a timer tick. Returns 1 if
+// it should yield: its slice is used up, or a process of higher
+// priority is waiting. Caller must hold p->lock.
+int
+rq_tick(struct proc *p)
+{
+  uint64 bitmap;
+
+  if(p->sleepavg > 0)
+    p->sleepavg--;
+  if(p->slice > 0)
+    p->slice--;
+  if(p->slice == 0)
+    return 1;
+
+  // read without rq.lock; a stale bitmap only delays the
+  // preemption to the next tick.
+  bitmap = rq.active->bitmap;
+  return bitmap != 0 && ffs64(bitmap) < p->prio;
+}
@@ -15,6 +15,12 @@ struct proc *initproc;
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// pid -> proc hash table, kept by allocproc() and freeproc(),
+// so that pid lookups need not scan proc[].
+#define NPIDHASH 64
+struct proc *pidhash[NPIDHASH];
+struct spinlock pidhash_lock;
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
 extern int freepagespace(void); //int function to return number of free pages
@@ -51,6 +57,7 @@ procinit(void)
   struct proc *p;
   
   initlock(&pid_lock, "nextpid");
+  initlock(&pidhash_lock, "pidhash");
   initlock(&wait_lock, "wait_lock");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
@@ -103,6 +110,63 @@ allocpid()
   return pid;
 }
 
+// Enter p, which has just been given its pid, in the pid hash.
+static void
+pidhash_add(struct proc *p)
+{
+  struct proc **head = &pidhash[(uint)p->pid % NPIDHASH];
+
+  acquire(&pidhash_lock);
+  p->pid_next = *head;
+  *head = p;
+  release(&pidhash_lock);
+}
+
+// Remove p from the pid hash, before its pid is cleared.
+static void
+pidhash_del(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pidhash_lock);
+  for(pp = &pidhash[(uint)p->pid % NPIDHASH]; *pp; pp = &(*pp)->pid_next){
+    if(*pp == p){
+      *pp = p->pid_next;
+      break;
+    }
+  }
+  release(&pidhash_lock);
+  p->pid_next = 0;
+}
+
+// Find the process with the given pid, and return it with
+// p->lock held, or 0 if there is none. Takes no other
+// process's lock. The caller must not hold pidhash_lock.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+
+  acquire(&pidhash_lock);
+  for(p = pidhash[(uint)pid % NPIDHASH]; p; p = p->pid_next)
+    if(p->pid == pid)
+      break;
+  release(&pidhash_lock);
+  if(p == 0)
+    return 0;
+
+  acquire(&p->lock);
+  // it may have exited and been freed in the meantime
+  if(p->pid != pid){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -124,8 +188,11 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  pidhash_add(p);
   p->state = USED;
   p->nice = 20; //default priority value
+  p->slice = timeslice(p->nice);
+  p->sleepavg = MAXSLEEPAVG / 2; //no bonus or penalty to start with
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -164,6 +231,8 @@ freeproc(struct proc *p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  if(p->pid)
+    pidhash_del(p);
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -172,6 +241,7 @@ freeproc(struct proc *p)
   p->xstate = 0;
   p->state = UNUSED;
   p->nice = 20;
+  p->sleepavg = 0;
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -230,6 +300,7 @@ userinit(void)
   p->cwd = namei("/");
 
   p->state = RUNNABLE;
+  rq_enqueue(p, 0);
 
   release(&p->lock);
 }
@@ -254,6 +325,54 @@ growproc(int n)
   return 0;
 }
 
+// Add p to the front of a children or zombies list.
+// Caller must hold wait_lock.
+static void
+sibling_add(struct proc **list, struct proc *p)
+{
+  p->sibling_prev = 0;
+  p->sibling_next = *list;
+  if(*list)
+    (*list)->sibling_prev = p;
+  *list = p;
+}
+
+// Take p off the children or zombies list it is on.
+// Caller must hold wait_lock.
+static void
+sibling_del(struct proc **list, struct proc *p)
+{
+  if(p->sibling_prev)
+    p->sibling_prev->sibling_next = p->sibling_next;
+  else
+    *list = p->sibling_next;
+  if(p->sibling_next)
+    p->sibling_next->sibling_prev = p->sibling_prev;
+  p->sibling_next = 0;
+  p->sibling_prev = 0;
+}
+
+// Move the whole list *from to the front of *to, making
+// parent the parent of each process on it.
+// Caller must hold wait_lock.
+static void
+sibling_splice(struct proc **from, struct proc **to, struct proc *parent)
+{
+  struct proc *pp, *last = 0;
+
+  for(pp = *from; pp; pp = pp->sibling_next){
+    pp->parent = parent;
+    last = pp;
+  }
+  if(last == 0)
+    return;
+  last->sibling_next = *to;
+  if(*to)
+    (*to)->sibling_prev = last;
+  *to = *from;
+  *from = 0;
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -296,28 +415,28 @@ kfork(void)
 
   acquire(&wait_lock);
   np->parent = p;
+  sibling_add(&p->children, np);
   release(&wait_lock);
 
   acquire(&np->lock);
   np->state = RUNNABLE;
+  rq_enqueue(np, 0);
   release(&np->lock);
 
   return pid;
 }
 
-// Pass p's abandoned children to init.
+// Pass p's abandoned children to init, exited ones
+// included, by splicing p's lists onto init's.
 // Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
-  struct proc *pp;
-
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
-  }
+  if(p->children == 0 && p->zombies == 0)
+    return;
+  sibling_splice(&p->children, &initproc->children, initproc);
+  sibling_splice(&p->zombies, &initproc->zombies, initproc);
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -350,6 +469,10 @@ kexit(int status)
   // Give any children to init.
   reparent(p);
 
+  // Move to the parent's exited children.
+  sibling_del(&p->parent->children, p);
+  sibling_add(&p->parent->zombies, p);
+
   // Parent might be sleeping in wait().
   wakeup(p->parent);
   
@@ -371,39 +494,32 @@ int
 kwait(uint64 addr)
 {
   struct proc *pp;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
-          release(&pp->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // Exited children are queued on p->zombies.
+    if((pp = p->zombies) != 0){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      pid = pp->pid;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                              sizeof(pp->xstate)) < 0) {
         release(&pp->lock);
+        release(&wait_lock);
+        return -1;
       }
+      sibling_del(&p->zombies, pp);
+      freeproc(pp);
+      release(&pp->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(p->children == 0 || killed(p)){
       release(&wait_lock);
       return -1;
     }
@@ -436,25 +552,25 @@ scheduler(void)
     intr_on();
     intr_off();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
+    // the highest priority RUNNABLE process, off the run queue.
+    // nobody else can take it now, though the cpu that queued
+    // it may hold p->lock until it has switched away.
+    if((p = rq_pick()) != 0) {
       acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
+      if(p->state != RUNNABLE)
+        panic("scheduler: not runnable");
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      c->proc = p;
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
       release(&p->lock);
-    }
-    if(found == 0) {
+    } else {
       // nothing to run; stop running on this core until an interrupt.
       asm volatile("wfi");
     }
@@ -489,12 +605,18 @@ sched(void)
 }
 
 // Give up the CPU for one scheduling round.
+// A process with slice left was preempted by a higher
+// priority, and keeps its place at the head of its own.
 void
 yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  if(p->slice > 0)
+    rq_enqueue(p, 1);
+  else
+    rq_expire(p);
   sched();
   release(&p->lock);
 }
@@ -556,6 +678,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sleepstart = ticks;
 
   sched();
 
@@ -579,6 +702,7 @@ wakeup(void *chan)
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        rq_wake(p);
       }
       release(&p->lock);
     }
@@ -593,20 +717,16 @@ kkill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    p->state = RUNNABLE;
+    rq_wake(p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -695,22 +815,18 @@ getpname(int pid)
 {
     struct proc *p;
 
-    //for loop to find pid
-    for(p = proc; p < &proc[NPROC]; p++)
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
     {
-        acquire(&p->lock);
-        //if pid found, print name
-        //return 0(success)
-        if(p->pid == pid)
-        {
-            printf("%s\n", p->name);
-            release(&p->lock);
-            return 0;
-        }
-        release(&p->lock);
+        //not found, return -1
+        return -1;
     }
-    //return -1 error
-    return -1;
+
+    //if pid found, print name
+    //return 0(success)
+    printf("%s\n", p->name);
+    release(&p->lock);
+    return 0;
 }
 
 //get nice value of the specified pid
@@ -719,22 +835,19 @@ int
 getnice(int pid)
 {
     struct proc *p;
+    int nice;
 
-    //find pid in list
-    //if found, return nice value
-    for(p = proc; p < &proc[NPROC]; p++)
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
     {
-        acquire(&p->lock);
-        if(p->pid == pid)
-        {
-            release(&p->lock);
-            return p->nice;
-        }
-        release(&p->lock);
+        //not found, return -1
+        return -1;
     }
 
-    //if not found, return -1
-    return -1;
+    //return nice value
+    nice = p->nice;
+    release(&p->lock);
+    return nice;
 }
 
 //set nice value of the specified pid
@@ -750,24 +863,20 @@ setnice(int pid, int value)
         return -1;
     }
 
-    //find pid in list
-    //if found, return nice value
-    for(p = proc; p < &proc[NPROC]; p++)
-    {    
-        acquire(&p->lock); 
-        //if process id = inputted pid
-        if(p->pid == pid)
-        {
-            // return 0 (success)
-            p->nice = value;
-            release(&p->lock);
-            return 0;
-        }
-        release(&p->lock);
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
     }
 
-    //if not found, return -1
-    return -1;
+    //a queued process moves to its new priority's list
+    p->nice = value;
+    rq_requeue(p);
+
+    // return 0 (success)
+    release(&p->lock);
+    return 0;
 }
 
 //ps: print out pid list, if 0 is inputted, print entire list
@@ -785,35 +894,26 @@ ps(int pid)
     };
     
     struct proc *p;
-    int pid_exists = 0; //boolean to check if pid exists
+    struct proc *first = proc, *last = &proc[NPROC]; //range to print
 
-    //check whether pid exists or is 0
-    for(p = proc; p < &proc[NPROC]; p++)
+    //a single pid: find it through the pid hash
+    if(pid != 0)
     {
-        acquire(&p->lock);
-
-        if(p->pid == pid)
+        //if pid does not exist, exit function
+        if((p = findproc(pid)) == 0)
         {
-            pid_exists = 1;
+            return;
         }
         release(&p->lock);
-    }
-    if(pid == 0)
-    {
-        pid_exists = 1;
-    }
-
-    //if pid does not exist, exit function
-    if(pid_exists == 0)
-    {
-        return;
+        first = p;
+        last = p + 1;
     }
     
     //list template
     printf("name\tpid\tstate\t\tpriority\n");
 
     //print process info
-    for(p = proc; p < &proc[NPROC]; p++)
+    for(p = first; p < last; p++)
     {
         acquire(&p->lock);
         if(pid == 0 || p->pid == pid)
@@ -849,7 +949,6 @@ int
 waitpid(int pid)
 {
     struct proc *p;
-    int pid_found;
     //current_p = current process
     struct proc *current_p = myproc();
    
@@ -857,46 +956,34 @@ waitpid(int pid)
     //infinite loop
     for(;;)
     {
-        pid_found = 0;
-
-        //Scan process table for pid and check if it's a child
-        for(p = proc; p < &proc[NPROC]; p++)
+        //find pid through the pid hash; it must be a child
+        //of the current process
+        p = findproc(pid);
+        if(p != 0 && p->parent != current_p)
         {
-            acquire(&p->lock);
-            //check if this is the right process
-            if(p->pid != pid)
-            {
-                release(&p->lock);
-                continue;
-            }
-
-            pid_found = 1;
-
-            //once process found, check if parent of found child is the current process
-            if(p->parent != current_p)
-            {
-                release(&p->lock);
-                release(&wait_lock);
-                return -1;
-            }
-           
-            //process is child of current process
-            //check for zombie state
-            if(p->state == ZOMBIE)
-            {
-                //free memory
-                freeproc(p);
-                release(&p->lock);
-                release(&wait_lock);
-                //return 0
-                return 0;
-            }
             release(&p->lock);
+            p = 0;
+        }
 
+        //process is child of current process
+        //check for zombie state
+        if(p != 0 && p->state == ZOMBIE)
+        {
+            //free memory
+            sibling_del(&current_p->zombies, p);
+            freeproc(p);
+            release(&p->lock);
+            release(&wait_lock);
+            //return 0
+            return 0;
+        }
+        if(p != 0)
+        {
+            release(&p->lock);
         }
 
         //if no such child or current process was killed, return error -1
-        if(!pid_found || current_p->killed)
+        if(p == 0 || current_p->killed)
         {
             release(&wait_lock);
             return -1;
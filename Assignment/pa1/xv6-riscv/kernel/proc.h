@@ -92,9 +92,25 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
   int nice;                    // priority (nice value)
+  int prio;                    // queue priority: nice adjusted by the sleep bonus
+  int slice;                   // ticks left of the time slice
+  int sleepavg;                // ticks slept less ticks run, 0 to MAXSLEEPAVG
+  uint sleepstart;             // ticks when it last went to sleep
 
-  // wait_lock must be held when using this:
+  // prio.c's rq.lock must be held when using these:
+  struct prioarray *rq_array;  // priority array it is queued in, or null
+  struct proc *rq_next;        // links in its priority's list
+  struct proc *rq_prev;
+
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // children that have not exited, newest first
+  struct proc *zombies;        // children that have exited, not yet waited for
+  struct proc *sibling_next;   // links in the parent's children or zombies list
+  struct proc *sibling_prev;
+
+  // pidhash_lock must be held when using this:
+  struct proc *pid_next;       // next in its pid hash chain
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -107,6 +107,7 @@ extern uint64 sys_setnice(void);
 extern uint64 sys_ps(void);
 extern uint64 sys_meminfo(void);
 extern uint64 sys_waitpid(void);
+extern uint64 sys_memstat(void);
 
 
 // An array mapping syscall numbers from syscall.h
@@ -139,6 +140,7 @@ static uint64 (*syscalls[])(void) = {
 [SYS_ps] sys_ps,
 [SYS_meminfo] sys_meminfo,
 [SYS_waitpid] sys_waitpid,
+[SYS_memstat] sys_memstat,
 };
 
 void
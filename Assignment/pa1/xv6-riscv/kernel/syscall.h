@@ -26,3 +26,4 @@
 #define SYS_ps     25
 #define SYS_meminfo 26
 #define SYS_waitpid 27
+#define SYS_memstat 28
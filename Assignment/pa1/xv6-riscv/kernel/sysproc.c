@@ -6,6 +6,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "vm.h"
+#include "memstat.h"
 
 uint64
 sys_exit(void)
@@ -170,3 +171,19 @@ sys_waitpid(void)
 
     return waitpid(pid);
 }
+
+//copy page counts by kind (memstat.h) into buf
+//returns 0, or -1 if error
+uint64
+sys_memstat(void)
+{
+    uint64 buf;
+    struct memstat st;
+    //get arguments
+    argaddr(0, &buf);
+
+    memstat_read(&st);
+    if(copyout(myproc()->pagetable, buf, (char*)&st, sizeof(st)) < 0)
+        return -1;
+    return 0;
+}
@@ -16,6 +16,22 @@ void kernelvec();
 
 extern int devintr();
 
+// charge the running process p for a timer tick, and give up
+// the CPU if that ends its time slice or a process of higher
+// priority is waiting. setnice() updates the same fields from
+// other harts, so take p->lock around rq_tick().
+static void
+prio_tick(struct proc *p)
+{
+  int preempt;
+
+  acquire(&p->lock);
+  preempt = p->state == RUNNING && rq_tick(p);
+  release(&p->lock);
+  if(preempt)
+    yield();
+}
+
 void
 trapinit(void)
 {
@@ -80,9 +96,10 @@ usertrap(void)
   if(killed(p))
     kexit(-1);
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if this is a timer interrupt that
+  // ends the time slice or finds a higher priority waiting.
   if(which_dev == 2)
-    yield();
+    prio_tick(p);
 
   prepare_return();
 
@@ -151,9 +168,10 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if this is a timer interrupt that
+  // ends the time slice or finds a higher priority waiting.
   if(which_dev == 2 && myproc() != 0)
-    yield();
+    prio_tick(myproc());
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -7,6 +7,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "fs.h"
+#include "memstat.h"
 
 /*
  * the kernel's page table.
@@ -25,6 +26,7 @@ kvmmake(void)
 
   kpgtbl = (pagetable_t) kalloc();
   memset(kpgtbl, 0, PGSIZE);
+  memcount(MEM_PGTBL, 1);
 
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
@@ -108,6 +110,7 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
       memset(pagetable, 0, PGSIZE);
+      memcount(MEM_PGTBL, 1);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -183,6 +186,7 @@ uvmcreate()
   if(pagetable == 0)
     return 0;
   memset(pagetable, 0, PGSIZE);
+  memcount(MEM_PGTBL, 1);
   return pagetable;
 }
 
@@ -206,6 +210,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     if(do_free){
       uint64 pa = PTE2PA(*pte);
       kfree((void*)pa);
+      memcount(MEM_USER, -1);
     }
     *pte = 0;
   }
@@ -235,6 +240,7 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
+    memcount(MEM_USER, 1);
   }
   return newsz;
 }
@@ -275,6 +281,7 @@ freewalk(pagetable_t pagetable)
     }
   }
   kfree((void*)pagetable);
+  memcount(MEM_PGTBL, -1);
 }
 
 // Free user memory pages,
@@ -315,6 +322,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
       kfree(mem);
       goto err;
     }
+    memcount(MEM_USER, 1);
   }
   return 0;
 
@@ -469,6 +477,7 @@ vmfault(pagetable_t pagetable, uint64 va, int read)
     kfree((void *)mem);
     return 0;
   }
+  memcount(MEM_USER, 1);
   return mem;
 }
 
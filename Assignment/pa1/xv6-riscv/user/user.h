@@ -1,6 +1,7 @@
 #define SBRK_ERROR ((char *)-1)
 
 struct stat;
+struct memstat;
 
 // system calls
 int fork(void);
@@ -30,6 +31,7 @@ int setnice(int, int);
 void ps(int);
 int meminfo(void);
 int waitpid(int);
+int memstat(struct memstat*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -48,3 +48,4 @@ entry("setnice");
 entry("ps");
 entry("meminfo");
 entry("waitpid");
+entry("memstat");
@@ -0,0 +1,159 @@
+//
+// CPU time accounting and load averages.
+//
+// Each CPU charges the time CSR cycles between mode switches to
+// the mode it was in: user (between prepare_return() and the next
+// usertrap()), idle (around wfi in scheduler()), or kernel (the
+// rest). Only that CPU writes its counters, with interrupts off.
+//
+// The load averages are exponentially decayed averages of the
+// number of RUNNING and RUNNABLE processes, sampled every
+// LOADFREQ cycles, in the fixed point Unix has always used.
+// clockintr() takes the samples. A CPU that runs a process keeps
+// taking timer interrupts, so samples are only missed while every
+// CPU sleeps in wfi; loadupdate() counts those as idle and only
+// the sample it takes now as the current number of processes.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "cpustat.h"
+#include "defs.h"
+
+#define LOADFREQ 50000000  // cycles between samples (5 s at 10 MHz)
+
+// 1/exp(5s/1min), 1/exp(5s/5min), 1/exp(5s/15min) in fixed point
+static const uint64 loadexp[3] = { 1884, 2014, 2037 };
+
+static uint64 loadavg[3];
+static uint64 loadnext;       // time CSR of the next sample
+static struct spinlock loadlock;
+
+void
+cpustatinit(void)
+{
+  initlock(&loadlock, "loadavg");
+}
+
+// charge this CPU's time since its last switch to the mode it
+// was in, and switch to mode.
+void
+cpuacct(int mode)
+{
+  struct cpu *c;
+  uint64 now;
+
+  push_off();
+  c = mycpu();
+  now = r_time();
+  if(c->acctstart != 0)
+    c->accttime[c->acctmode] += now - c->acctstart;
+  c->acctmode = mode;
+  c->acctstart = now;
+  pop_off();
+}
+
+// x to the n, both fixed point.
+static uint64
+fixed_power(uint64 x, uint64 n)
+{
+  uint64 result = FIXED_1;
+
+  while(n){
+    if(n & 1)
+      result = (result * x + FIXED_1 / 2) >> FSHIFT;
+    n >>= 1;
+    x = (x * x + FIXED_1 / 2) >> FSHIFT;
+  }
+  return result;
+}
+
+// decay load toward active over n samples.
+static uint64
+calc_load(uint64 load, uint64 exp, uint64 active, uint64 n)
+{
+  uint64 newload;
+
+  exp = fixed_power(exp, n);
+  newload = load * exp + active * (FIXED_1 - exp);
+  if(active >= load)
+    newload += FIXED_1 - 1;
+  return newload >> FSHIFT;
+}
+
+// take the load samples that are due. called from clockintr().
+void
+loadupdate(void)
+{
+  uint64 now = r_time(), n, active;
+  int i;
+
+  if(now < loadnext)
+    return;
+  acquire(&loadlock);
+  if(now >= loadnext){
+    n = (now - loadnext) / LOADFREQ + 1;
+    if(loadnext == 0)
+      n = 1;
+    loadnext = now - now % LOADFREQ + LOADFREQ;
+    active = (uint64)nr_running() << FSHIFT;
+    for(i = 0; i < 3; i++){
+      if(n > 1)
+        loadavg[i] = calc_load(loadavg[i], loadexp[i], 0, n - 1);
+      loadavg[i] = calc_load(loadavg[i], loadexp[i], active, 1);
+    }
+  }
+  release(&loadlock);
+}
+
+// copy CPU times and load averages (cpustat.h) to user addr.
+// returns 0, or -1 if error
+int
+cpustat(uint64 addr)
+{
+  struct cpustat st;
+  struct cpu *c;
+  uint64 now;
+  int i;
+
+  memset(&st, 0, sizeof(st));
+
+  // bring this CPU's counters up to date; others are charged
+  // up to their last switch, and the running interval is added
+  // below.
+  cpuacct(CPU_KERNEL);
+  loadupdate();
+
+  now = r_time();
+  st.time = now;
+  acquire(&loadlock);
+  for(i = 0; i < 3; i++)
+    st.load[i] = loadavg[i];
+  release(&loadlock);
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->acctstart == 0)  // not yet in scheduler()
+      continue;
+    i = st.ncpu++;
+    st.cpu[i].user = c->accttime[CPU_USER];
+    st.cpu[i].kernel = c->accttime[CPU_KERNEL];
+    st.cpu[i].idle = c->accttime[CPU_IDLE];
+    // racy read of another CPU's open interval: good enough for
+    // a monitor, and never negative.
+    if(c->acctstart != 0 && now > c->acctstart){
+      switch(c->acctmode){
+      case CPU_USER:   st.cpu[i].user += now - c->acctstart; break;
+      case CPU_IDLE:   st.cpu[i].idle += now - c->acctstart; break;
+      default:         st.cpu[i].kernel += now - c->acctstart; break;
+      }
+    }
+  }
+
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
@@ -1,9 +1,13 @@
 struct buf;
 struct context;
+struct cpu;
 struct file;
 struct inode;
+struct memstat;
 struct pipe;
 struct proc;
+struct rtqueue;
+struct runqueue;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -22,6 +26,37 @@ void            consoleinit(void);
 void            consoleintr(int);
 void            consputc(int);
 
+// cpustat.c
+void            cpustatinit(void);
+void            cpuacct(int);
+void            loadupdate(void);
+int             cpustat(uint64);
+
+// eevdf.c
+void            rq_enqueue(struct runqueue*, struct proc*);
+void            rq_dequeue(struct runqueue*, struct proc*);
+struct proc*    rq_pick(struct runqueue*);
+struct proc*    rq_first(struct runqueue*);
+struct proc*    rq_next(struct proc*);
+int             rq_eligible(struct runqueue*, struct proc*);
+void            rq_attach(struct runqueue*, struct proc*);
+void            rq_detach(struct runqueue*, struct proc*);
+int             rq_preempt(struct runqueue*, struct proc*);
+void            rq_update_curr(struct runqueue*, struct proc*);
+void            rq_reweight_curr(struct runqueue*, struct proc*, int);
+struct runqueue* rq_pick_group(struct cpu*);
+uint64          rq_avg_vruntime(struct runqueue*);
+void            rq_place(struct runqueue*, struct proc*);
+void            rq_migrate(struct proc*, struct runqueue*, struct runqueue*);
+struct proc*    rq_pick_next(struct cpu*);
+int             rq_wake(struct runqueue*, struct proc*);
+void            rq_sleep(struct runqueue*, struct proc*);
+uint64          vscale(struct proc*, uint64);
+void            charge(struct proc*, uint64);
+void            new_slice(struct proc*);
+long            clamp_lag(struct proc*, long);
+long            decay_lag(long, uint64);
+
 // exec.c
 int             kexec(char*, char**);
 
@@ -60,6 +95,8 @@ void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
 int             freepagespace(void);
+void            memcount(int, int);
+void            memstat_read(struct memstat*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -83,7 +120,6 @@ int             cpuid(void);
 void            kexit(int);
 int             kfork(void);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kkill(int);
@@ -106,8 +142,29 @@ int             getpname(int);
 int             getnice(int);
 int             setnice(int, int);
 void            ps(int);
+int             procsnap(uint64, int);
+int             nr_running(void);
 int            meminfo(void);
 int             waitpid(int);
+int             getslice(int);
+int             setslice(int, int);
+int             getgroup(int);
+int             setgroup(int, int);
+int             setgroupnice(int, int);
+int             getaffinity(int);
+int             setaffinity(int, int);
+int             getscheduler(int, uint64);
+int             setscheduler(int, int, int);
+uint64          update_runtime(struct proc*);
+
+// rt.c
+void            rt_enqueue(struct rtqueue*, struct proc*, int);
+void            rt_dequeue(struct rtqueue*, struct proc*);
+int             rt_top(struct rtqueue*);
+struct proc*    rt_pick(struct rtqueue*);
+struct proc*    rt_next(struct rtqueue*, struct proc*);
+void            rt_charge(struct rtqueue*, uint64);
+int             rt_throttled(struct rtqueue*);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -148,8 +205,17 @@ extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
+extern uint     tickexpiry;
+void            tickupdate(void);
+void            settimer(void);
+void            sendipi(int);
 void            prepare_return(void);
 
+// trace.c
+void            traceinit(void);
+void            tracesched(int, struct proc*);
+int             schedtrace(uint64, int);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
@@ -161,6 +227,7 @@ int             uartgetc(void);
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
+int             kvmmapstack(uint64);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
@@ -0,0 +1,831 @@
+// EEVDF run queue.
+//
+// RUNNABLE processes are kept in a red-black tree ordered by
+// vdeadline. Each node also caches the smallest vruntime in its
+// subtree (min_vruntime), so the scheduler can find the eligible
+// process with the earliest virtual deadline in O(log n) instead
+// of scanning proc[].
+//
+// Every CPU has a run queue per process group (struct cpu's
+// rq[]); vruntimes are only comparable between processes on the
+// same queue.
+//
+// For eligibility, the queue keeps running sums over its queued
+// processes plus the one running on its CPU (rq->curr):
+//   total_weight      = sum(w_i)
+//   weighted_vruntime = sum(w_i * (v_i - min_vruntime))
+// so the average vruntime is known in O(1) at any time.
+//
+// Groups are scheduled by EEVDF too, one level up: a CPU first
+// picks among its groups, then among the chosen group's
+// processes. Each group's queue carries the group's entity on
+// that CPU (gvruntime, gvdeadline, gweight), which is active
+// while the group has a process queued or running there. The
+// group's weight is split between CPUs in proportion to its
+// load on each, so a group gets the same share however many
+// processes it has. There are only NGROUP groups, so the group
+// level scans them rather than keeping a tree.
+//
+// The caller must hold the CPU's rqlock. A queued process's
+// vruntime, vdeadline and weight are tree keys: dequeue it
+// before changing them, and enqueue it again afterwards.
+//
+// Nothing here touches hardware or locks: time comes in as
+// milliticks through update_runtime(). sim/eevdfsim.c builds
+// this file for the host to run it against synthetic loads.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+// weight table given in PDF
+const int weight_table[] = { /* 0 */    88761,  71755,  56483,  46273,  36291,
+                        /*  5 */    29154,  23254,  18705,  14949,  11916,
+                        /* 10 */    9548,   7620,   6100,   4904,   3906,
+                        /* 15 */    3121,   2501,   1991,   1586,   1277,
+                        /* 20 */    1024,   820,    655,    526,    423,
+                        /* 25 */    335,    272,    215,    172,    137,
+                        /* 30 */    110,    87,     70,     56,     45,
+                        /* 35 */    36,     29,     23,     18,     15
+                        };
+// 2^32 / weight_table[i], so that scaling by 1024 / weight
+// is a multiply and a shift instead of a division
+static const uint64 weight_inv_table[] = {
+                        /*  0 */     48388,     59856,     76040,     92818,    118348,
+                        /*  5 */    147320,    184698,    229616,    287308,    360437,
+                        /* 10 */    449829,    563644,    704093,    875809,   1099582,
+                        /* 15 */   1376151,   1717300,   2157191,   2708050,   3363326,
+                        /* 20 */   4194304,   5237765,   6557202,   8165337,  10153587,
+                        /* 25 */  12820798,  15790321,  19976592,  24970740,  31350126,
+                        /* 30 */  39045157,  49367440,  61356676,  76695844,  95443717,
+                        /* 35 */ 119304647, 148102320, 186737708, 238609294, 286331153
+                        };
+
+// scale a runtime delta (milliticks) to virtual time:
+// delta * 1024 / weight, using the precomputed inverse weight
+uint64
+vscale(struct proc *p, uint64 delta)
+{
+  return (delta * 1024 * weight_inv_table[p->nice]) >> 32;
+}
+
+// Charge p for delta milliticks of running: its runtime,
+// timeslice and vruntime. p must be detached from its run
+// queue's sums (see rq_update_curr()).
+void
+charge(struct proc *p, uint64 delta)
+{
+  p->runtime += delta;
+  p->timeslice -= delta;
+  p->vruntime += vscale(p, delta);
+}
+
+// Give p a fresh time slice, and the virtual deadline that
+// goes with it: vdeadline = vruntime + slice * 1024 / weight.
+void
+new_slice(struct proc *p)
+{
+  p->timeslice = p->slice;
+  p->vdeadline = p->vruntime + vscale(p, p->slice);
+}
+
+// bound a lag to two of p's slices of its virtual time,
+// so that no sleeper is owed or owes more.
+long
+clamp_lag(struct proc *p, long lag)
+{
+  long limit = vscale(p, 2 * p->slice);
+
+  if(lag > limit)
+    return limit;
+  if(lag < -limit)
+    return -limit;
+  return lag;
+}
+
+// halve a sleeper's lag for every default slice (BASESLICE) it
+// slept, so that a long sleep neither banks credit nor carries
+// old debt. slept is in milliticks.
+long
+decay_lag(long lag, uint64 slept)
+{
+  uint64 halvings = slept / BASESLICE;
+
+  if(halvings >= 63)
+    return 0;
+  return lag / (1L << halvings);
+}
+
+// recompute p's cached subtree minimum from its children.
+static void
+update_min(struct proc *p)
+{
+  uint64 min = p->vruntime;
+
+  if(p->rb_left && p->rb_left->min_vruntime < min)
+    min = p->rb_left->min_vruntime;
+  if(p->rb_right && p->rb_right->min_vruntime < min)
+    min = p->rb_right->min_vruntime;
+  p->min_vruntime = min;
+}
+
+// refresh the cached minimums from p up to the root.
+static void
+propagate(struct proc *p)
+{
+  for(; p; p = p->rb_parent)
+    update_min(p);
+}
+
+// make v take u's place under u's parent.
+static void
+transplant(struct runqueue *rq, struct proc *u, struct proc *v)
+{
+  if(u->rb_parent == 0)
+    rq->root = v;
+  else if(u == u->rb_parent->rb_left)
+    u->rb_parent->rb_left = v;
+  else
+    u->rb_parent->rb_right = v;
+  if(v)
+    v->rb_parent = u->rb_parent;
+}
+
+static void
+rotate_left(struct runqueue *rq, struct proc *x)
+{
+  struct proc *y = x->rb_right;
+
+  x->rb_right = y->rb_left;
+  if(y->rb_left)
+    y->rb_left->rb_parent = x;
+  transplant(rq, x, y);
+  y->rb_left = x;
+  x->rb_parent = y;
+
+  // only x and y changed subtrees.
+  update_min(x);
+  update_min(y);
+}
+
+static void
+rotate_right(struct runqueue *rq, struct proc *x)
+{
+  struct proc *y = x->rb_left;
+
+  x->rb_left = y->rb_right;
+  if(y->rb_right)
+    y->rb_right->rb_parent = x;
+  transplant(rq, x, y);
+  y->rb_right = x;
+  x->rb_parent = y;
+
+  update_min(x);
+  update_min(y);
+}
+
+static int
+is_red(struct proc *p)
+{
+  return p != 0 && p->rb_red;
+}
+
+static void
+insert_fixup(struct runqueue *rq, struct proc *p)
+{
+  struct proc *parent, *gparent, *uncle;
+
+  while((parent = p->rb_parent) != 0 && parent->rb_red){
+    gparent = parent->rb_parent;
+    if(parent == gparent->rb_left){
+      uncle = gparent->rb_right;
+      if(is_red(uncle)){
+        parent->rb_red = 0;
+        uncle->rb_red = 0;
+        gparent->rb_red = 1;
+        p = gparent;
+        continue;
+      }
+      if(p == parent->rb_right){
+        rotate_left(rq, parent);
+        p = parent;
+        parent = p->rb_parent;
+      }
+      parent->rb_red = 0;
+      gparent->rb_red = 1;
+      rotate_right(rq, gparent);
+    } else {
+      uncle = gparent->rb_left;
+      if(is_red(uncle)){
+        parent->rb_red = 0;
+        uncle->rb_red = 0;
+        gparent->rb_red = 1;
+        p = gparent;
+        continue;
+      }
+      if(p == parent->rb_left){
+        rotate_right(rq, parent);
+        p = parent;
+        parent = p->rb_parent;
+      }
+      parent->rb_red = 0;
+      gparent->rb_red = 1;
+      rotate_left(rq, gparent);
+    }
+  }
+  rq->root->rb_red = 0;
+}
+
+// restore the red-black properties after removing a black node.
+// x (possibly null) took the removed node's place under parent.
+static void
+erase_fixup(struct runqueue *rq, struct proc *x, struct proc *parent)
+{
+  struct proc *w;
+
+  while(x != rq->root && !is_red(x)){
+    if(x == parent->rb_left){
+      w = parent->rb_right;
+      if(w->rb_red){
+        w->rb_red = 0;
+        parent->rb_red = 1;
+        rotate_left(rq, parent);
+        w = parent->rb_right;
+      }
+      if(!is_red(w->rb_left) && !is_red(w->rb_right)){
+        w->rb_red = 1;
+        x = parent;
+        parent = x->rb_parent;
+        continue;
+      }
+      if(!is_red(w->rb_right)){
+        w->rb_left->rb_red = 0;
+        w->rb_red = 1;
+        rotate_right(rq, w);
+        w = parent->rb_right;
+      }
+      w->rb_red = parent->rb_red;
+      parent->rb_red = 0;
+      w->rb_right->rb_red = 0;
+      rotate_left(rq, parent);
+    } else {
+      w = parent->rb_left;
+      if(w->rb_red){
+        w->rb_red = 0;
+        parent->rb_red = 1;
+        rotate_right(rq, parent);
+        w = parent->rb_left;
+      }
+      if(!is_red(w->rb_left) && !is_red(w->rb_right)){
+        w->rb_red = 1;
+        x = parent;
+        parent = x->rb_parent;
+        continue;
+      }
+      if(!is_red(w->rb_left)){
+        w->rb_right->rb_red = 0;
+        w->rb_red = 1;
+        rotate_left(rq, w);
+        w = parent->rb_left;
+      }
+      w->rb_red = parent->rb_red;
+      parent->rb_red = 0;
+      w->rb_left->rb_red = 0;
+      rotate_right(rq, parent);
+    }
+    x = rq->root;
+  }
+  if(x)
+    x->rb_red = 0;
+}
+
+// p's vruntime relative to the queue's baseline.
+// negative if p is behind it, e.g. after migrating.
+static long
+key(struct runqueue *rq, struct proc *p)
+{
+  return (long)(p->vruntime - rq->min_vruntime);
+}
+
+static void
+avg_add(struct runqueue *rq, struct proc *p)
+{
+  rq->weighted_vruntime += key(rq, p) * p->weight;
+  rq->total_weight += p->weight;
+}
+
+static void
+avg_sub(struct runqueue *rq, struct proc *p)
+{
+  rq->weighted_vruntime -= key(rq, p) * p->weight;
+  rq->total_weight -= p->weight;
+}
+
+// a vruntime is eligible if it is not past the weighted average
+// vruntime of the queue:
+//   sum(w_i * (v_i - min)) >= (v - min) * sum(w_i)
+static int
+vruntime_eligible(struct runqueue *rq, uint64 vruntime)
+{
+  long v = (long)(vruntime - rq->min_vruntime);
+
+  return rq->weighted_vruntime >= v * rq->total_weight;
+}
+
+// the group rq belongs to.
+static struct group*
+group_of(struct runqueue *rq)
+{
+  return &groups[rq - rq->cpu->rq];
+}
+
+// rq's group's share of its weight on rq's CPU, in proportion to
+// the group's load there. other CPUs' loads are read without
+// their locks, so they may be stale; that is fine, as the share
+// is only a hint and is refreshed at every pick.
+static int
+group_share(struct runqueue *rq)
+{
+  int g = rq - rq->cpu->rq;
+  uint64 total = 0;
+  struct cpu *c;
+  int share;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    total += __atomic_load_n(&c->rq[g].total_weight, __ATOMIC_RELAXED);
+  if(total == 0 || total < (uint64)rq->total_weight)
+    return group_of(rq)->weight;
+
+  share = (uint64)group_of(rq)->weight * rq->total_weight / total;
+  // don't let a group's entity starve on a CPU it barely uses.
+  if(share < 2)
+    share = 2;
+  return share;
+}
+
+// refresh rq's group's share of its weight, and its inverse
+// when the share changed.
+static void
+group_reweight(struct runqueue *rq)
+{
+  int w = group_share(rq);
+
+  if(w != rq->gweight){
+    rq->gweight = w;
+    rq->ginv_weight = ((uint64)1 << 32) / w;
+  }
+}
+
+// scale a runtime delta (milliticks) to rq's group's virtual
+// time: delta * 1024 / gweight, as vscale() does for a process.
+static uint64
+gvscale(struct runqueue *rq, uint64 delta)
+{
+  return (delta * 1024 * rq->ginv_weight) >> 32;
+}
+
+// the weighted average vruntime of c's active groups, leaving
+// out skip (if not 0). sets *weight to their total weight.
+static uint64
+group_avg(struct cpu *c, struct runqueue *skip, long *weight)
+{
+  struct runqueue *rq;
+  uint64 base = 0;
+  long sum = 0, total = 0;
+  int any = 0;
+
+  for(rq = c->rq; rq < &c->rq[NGROUP]; rq++){
+    if(rq == skip || rq->total_weight == 0)
+      continue;
+    if(!any || rq->gvruntime < base)
+      base = rq->gvruntime;
+    any = 1;
+  }
+  *weight = 0;
+  if(!any)
+    return c->gvclock;
+
+  for(rq = c->rq; rq < &c->rq[NGROUP]; rq++){
+    if(rq == skip || rq->total_weight == 0)
+      continue;
+    sum += (long)(rq->gvruntime - base) * rq->gweight;
+    total += rq->gweight;
+  }
+  *weight = total;
+  if(skip == 0)
+    c->gvclock = base + sum / total;
+  return base + sum / total;
+}
+
+// rq's group has just become active on its CPU: place its entity
+// at its lag from the other active groups' average, with a
+// fresh deadline.
+static void
+group_activate(struct runqueue *rq)
+{
+  long weight;
+  long lag = rq->gvlag;
+  uint64 avg = group_avg(rq->cpu, rq, &weight);
+
+  group_reweight(rq);
+  // as in rq_place(), compensate for rq pulling the average.
+  if(weight > 0)
+    lag = lag * (weight + rq->gweight) / weight;
+  rq->gvruntime = avg - lag;
+  rq->gvdeadline = rq->gvruntime + gvscale(rq, BASESLICE);
+}
+
+// rq's group is about to go inactive on its CPU: remember its
+// lag, bounded to two base slices, to place it again later.
+static void
+group_deactivate(struct runqueue *rq)
+{
+  long weight;
+  long limit = gvscale(rq, 2 * BASESLICE);
+  long lag = (long)(group_avg(rq->cpu, 0, &weight) - rq->gvruntime);
+
+  if(lag > limit)
+    lag = limit;
+  if(lag < -limit)
+    lag = -limit;
+  rq->gvlag = lag;
+}
+
+// advance the queue's baseline to the smallest vruntime among its
+// queued and running processes. it never moves backwards; every
+// key shrinks by the same amount, so the weighted sum is shifted
+// rather than recomputed.
+static void
+update_baseline(struct runqueue *rq)
+{
+  uint64 min;
+
+  if(rq->curr)
+    min = rq->curr->vruntime;
+  else if(rq->root)
+    min = rq->root->min_vruntime;
+  else
+    return;
+  if(rq->root && rq->root->min_vruntime < min)
+    min = rq->root->min_vruntime;
+
+  if(min > rq->min_vruntime){
+    rq->weighted_vruntime -= (long)(min - rq->min_vruntime) * rq->total_weight;
+    rq->min_vruntime = min;
+  }
+}
+
+// Insert p into the run queue.
+void
+rq_enqueue(struct runqueue *rq, struct proc *p)
+{
+  struct proc **link = &rq->root;
+  struct proc *parent = 0;
+
+  if(p->on_rq)
+    panic("rq_enqueue");
+
+  while(*link){
+    parent = *link;
+    // equal deadlines go right, so they run in FIFO order.
+    if(p->vdeadline < parent->vdeadline)
+      link = &parent->rb_left;
+    else
+      link = &parent->rb_right;
+  }
+
+  p->rb_parent = parent;
+  p->rb_left = 0;
+  p->rb_right = 0;
+  p->rb_red = 1;
+  p->min_vruntime = p->vruntime;
+  *link = p;
+
+  propagate(parent);
+  insert_fixup(rq, p);
+
+  p->on_rq = 1;
+  rq->nr_running++;
+  avg_add(rq, p);
+  if(rq->total_weight == p->weight)
+    group_activate(rq);
+  update_baseline(rq);
+}
+
+// Remove p from the run queue.
+void
+rq_dequeue(struct runqueue *rq, struct proc *p)
+{
+  struct proc *child, *parent, *s;
+  int red;
+
+  if(!p->on_rq)
+    panic("rq_dequeue");
+
+  if(p->rb_left == 0 || p->rb_right == 0){
+    child = p->rb_left ? p->rb_left : p->rb_right;
+    parent = p->rb_parent;
+    red = p->rb_red;
+    transplant(rq, p, child);
+  } else {
+    // replace p with its in-order successor s.
+    s = p->rb_right;
+    while(s->rb_left)
+      s = s->rb_left;
+    child = s->rb_right;
+    red = s->rb_red;
+    if(s->rb_parent == p){
+      parent = s;
+    } else {
+      parent = s->rb_parent;
+      transplant(rq, s, child);
+      s->rb_right = p->rb_right;
+      s->rb_right->rb_parent = s;
+    }
+    transplant(rq, p, s);
+    s->rb_left = p->rb_left;
+    s->rb_left->rb_parent = s;
+    s->rb_red = p->rb_red;
+  }
+
+  propagate(parent);
+  if(!red)
+    erase_fixup(rq, child, parent);
+
+  p->rb_parent = p->rb_left = p->rb_right = 0;
+  p->on_rq = 0;
+  rq->nr_running--;
+  if(rq->total_weight == p->weight)
+    group_deactivate(rq);
+  avg_sub(rq, p);
+  update_baseline(rq);
+}
+
+// Count p, now running on the queue's CPU, in the queue's
+// averages. p is not in the tree while it runs.
+void
+rq_attach(struct runqueue *rq, struct proc *p)
+{
+  if(rq->curr)
+    panic("rq_attach");
+  rq->curr = p;
+  avg_add(rq, p);
+  if(rq->total_weight == p->weight)
+    group_activate(rq);
+  update_baseline(rq);
+}
+
+// Stop counting the running process p. Detach it before changing
+// its vruntime or weight, and attach it again afterwards.
+void
+rq_detach(struct runqueue *rq, struct proc *p)
+{
+  if(rq->curr != p)
+    panic("rq_detach");
+  if(rq->total_weight == p->weight)
+    group_deactivate(rq);
+  avg_sub(rq, p);
+  rq->curr = 0;
+  update_baseline(rq);
+}
+
+// Give the running process p a new weight. Unlike a detach and
+// attach, this keeps its group active. Charge p with
+// rq_update_curr() first, so that the time it has run is
+// scaled by its old weight. p->lock must be held.
+void
+rq_reweight_curr(struct runqueue *rq, struct proc *p, int weight)
+{
+  if(rq->curr != p)
+    panic("rq_reweight_curr");
+  avg_sub(rq, p);
+  p->weight = weight;
+  avg_add(rq, p);
+  update_baseline(rq);
+}
+
+// Charge the running process p, and its group, for the time it
+// has run. p->lock must be held.
+void
+rq_update_curr(struct runqueue *rq, struct proc *p)
+{
+  uint64 delta;
+
+  if(rq->curr != p)
+    panic("rq_update_curr");
+
+  // p's vruntime is part of the queue's sums.
+  avg_sub(rq, p);
+  delta = update_runtime(p);
+  avg_add(rq, p);
+  update_baseline(rq);
+
+  rq->gvruntime += gvscale(rq, delta);
+  if(rq->gvruntime >= rq->gvdeadline)
+    rq->gvdeadline = rq->gvruntime + gvscale(rq, BASESLICE);
+}
+
+// Return the run queue of the group c should run next: the
+// eligible group with the earliest deadline among those with a
+// queued process, or 0 if there is none. Also refreshes each
+// group's share of its weight on c.
+struct runqueue*
+rq_pick_group(struct cpu *c)
+{
+  struct runqueue *rq, *best = 0, *first = 0;
+  uint64 avg;
+  long weight;
+
+  for(rq = c->rq; rq < &c->rq[NGROUP]; rq++)
+    if(rq->total_weight > 0)
+      group_reweight(rq);
+  avg = group_avg(c, 0, &weight);
+
+  for(rq = c->rq; rq < &c->rq[NGROUP]; rq++){
+    if(rq->nr_running == 0)
+      continue;
+    if(first == 0 || rq->gvdeadline < first->gvdeadline)
+      first = rq;
+    if(rq->gvruntime <= avg && (best == 0 || rq->gvdeadline < best->gvdeadline))
+      best = rq;
+  }
+
+  // as in rq_pick(), fall back to the earliest deadline.
+  return best ? best : first;
+}
+
+// Return the eligible process with the earliest vdeadline,
+// or 0 if the queue is empty. Does not dequeue it.
+struct proc*
+rq_pick(struct runqueue *rq)
+{
+  struct proc *node = rq->root;
+
+  while(node){
+    // an eligible process in the left subtree always has an
+    // earlier deadline than this node.
+    if(node->rb_left && vruntime_eligible(rq, node->rb_left->min_vruntime)){
+      node = node->rb_left;
+      continue;
+    }
+    // the left subtree has nothing eligible, so this node is the
+    // earliest deadline that might be.
+    if(vruntime_eligible(rq, node->vruntime))
+      return node;
+    node = node->rb_right;
+  }
+
+  // the smallest queued vruntime is always eligible unless the
+  // running process is further behind; then take the earliest
+  // deadline.
+  node = rq->root;
+  while(node && node->rb_left)
+    node = node->rb_left;
+  return node;
+}
+
+// Take the next fair process for c off its run queue: the
+// pick of rq_pick() in the group rq_pick_group() chooses.
+// Returns 0 if c has no queued fair process.
+struct proc*
+rq_pick_next(struct cpu *c)
+{
+  struct runqueue *rq;
+  struct proc *p;
+
+  if((rq = rq_pick_group(c)) == 0)
+    return 0;
+  p = rq_pick(rq);
+  if(p)
+    rq_dequeue(rq, p);
+  return p;
+}
+
+// The queued process with the earliest vdeadline, or 0.
+struct proc*
+rq_first(struct runqueue *rq)
+{
+  struct proc *node = rq->root;
+
+  while(node && node->rb_left)
+    node = node->rb_left;
+  return node;
+}
+
+// The queued process after p in vdeadline order, or 0.
+struct proc*
+rq_next(struct proc *p)
+{
+  if(p->rb_right){
+    p = p->rb_right;
+    while(p->rb_left)
+      p = p->rb_left;
+    return p;
+  }
+  while(p->rb_parent && p == p->rb_parent->rb_right)
+    p = p->rb_parent;
+  return p->rb_parent;
+}
+
+// The weighted average vruntime of the queue, including its
+// running process: the point at which a process has zero lag.
+uint64
+rq_avg_vruntime(struct runqueue *rq)
+{
+  long avg = 0;
+
+  if(rq->total_weight > 0)
+    avg = rq->weighted_vruntime / rq->total_weight;
+  return rq->min_vruntime + avg;
+}
+
+// Set the vruntime of p, which is about to be enqueued, so that
+// its lag relative to the queue's average is p->vlag.
+void
+rq_place(struct runqueue *rq, struct proc *p)
+{
+  long lag = p->vlag;
+
+  // adding p pulls the average towards p's vruntime and would
+  // shrink its lag by w / (W + w); scale it up to compensate.
+  if(rq->total_weight > 0)
+    lag = lag * (rq->total_weight + p->weight) / rq->total_weight;
+  p->vruntime = rq_avg_vruntime(rq) - lag;
+}
+
+// Queue p, which has just become runnable, at its lag p->vlag
+// with a fresh virtual deadline. Returns whether it should
+// preempt the process running on the queue's CPU.
+int
+rq_wake(struct runqueue *rq, struct proc *p)
+{
+  rq_place(rq, p);
+  p->vdeadline = p->vruntime + vscale(p, p->slice);
+  rq_enqueue(rq, p);
+  p->is_eligible = rq_eligible(rq, p);
+  return rq_preempt(rq, p);
+}
+
+// The running process p is going to sleep: remember its lag,
+// to place it again on wakeup.
+void
+rq_sleep(struct runqueue *rq, struct proc *p)
+{
+  p->vlag = clamp_lag(p, (long)(rq_avg_vruntime(rq) - p->vruntime));
+}
+
+// Should queued process p preempt the process running on the
+// queue's CPU? Yes if nothing runs there. If it is of p's group,
+// yes if p is eligible and has an earlier deadline; if not, the
+// same goes for p's group against the running one. curr's
+// deadline is read without its p->lock, so this is only a hint.
+int
+rq_preempt(struct runqueue *rq, struct proc *p)
+{
+  struct cpu *c = rq->cpu;
+  struct runqueue *running;
+  long weight;
+
+  // a running real-time process gives way only once the CPU
+  // has used up its real-time budget.
+  if(c->rt.curr)
+    return rt_throttled(&c->rt);
+
+  for(running = c->rq; running < &c->rq[NGROUP]; running++)
+    if(running->curr)
+      break;
+  if(running == &c->rq[NGROUP])
+    return 1;
+
+  if(running == rq)
+    return vruntime_eligible(rq, p->vruntime) && p->vdeadline < rq->curr->vdeadline;
+  return rq->gvruntime <= group_avg(c, 0, &weight) &&
+         rq->gvdeadline < running->gvdeadline;
+}
+
+// Is queued process p eligible to run?
+int
+rq_eligible(struct runqueue *rq, struct proc *p)
+{
+  if(!p->on_rq)
+    return 0;
+  return vruntime_eligible(rq, p->vruntime);
+}
+
+// Rebase a dequeued process from one queue's vruntime baseline
+// to another's, so it keeps its position relative to its peers
+// when it migrates. The baselines are read without their locks;
+// they only grow, so a slightly stale value is harmless.
+void
+rq_migrate(struct proc *p, struct runqueue *from, struct runqueue *to)
+{
+  uint64 src = from->min_vruntime;
+  uint64 dst = to->min_vruntime;
+
+  p->vruntime = p->vruntime - src + dst;
+  p->vdeadline = p->vdeadline - src + dst;
+}
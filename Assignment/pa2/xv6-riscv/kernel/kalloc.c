@@ -8,6 +8,7 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "memstat.h"
 
 void freerange(void *pa_start, void *pa_end);
 
@@ -23,6 +24,17 @@ struct {
   struct run *freelist;
 } kmem;
 
+// pages of each kind, counted per CPU so that counting takes no
+// lock and shares no cache line. a CPU changes only its own
+// counts, with interrupts off. pages counted on one CPU may be
+// uncounted on another, so a single CPU's count means nothing;
+// only the sum over CPUs does.
+static struct {
+  long n[NMEMKIND];
+} __attribute__((aligned(64))) memcounts[NCPU];
+
+static uint64 totalpages;
+
 void
 kinit()
 {
@@ -35,8 +47,10 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
     kfree(p);
+    totalpages++;
+  }
 }
 
 // Free the page of physical memory pointed at by pa,
@@ -60,6 +74,7 @@ kfree(void *pa)
   r->next = kmem.freelist;
   kmem.freelist = r;
   release(&kmem.lock);
+  memcount(MEM_FREE, 1);
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -76,27 +91,55 @@ kalloc(void)
     kmem.freelist = r->next;
   release(&kmem.lock);
 
-  if(r)
+  if(r){
     memset((char*)r, 5, PGSIZE); // fill with junk
+    memcount(MEM_FREE, -1);
+  }
   return (void*)r;
 }
 
+// count n pages (negative to uncount) as being of the given
+// kind (memstat.h).
+void
+memcount(int kind, int n)
+{
+  push_off();
+  memcounts[cpuid()].n[kind] += n;
+  pop_off();
+}
+
+// sum of every CPU's count of kind. only as exact as the
+// unlocked reads of the other CPUs' counts.
+static uint64
+memsum(int kind)
+{
+  long n = 0;
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    n += memcounts[i].n[kind];
+  return n < 0 ? 0 : n;
+}
+
+// fill in *st from the counts.
+void
+memstat_read(struct memstat *st)
+{
+  uint64 used;
+
+  st->total = totalpages;
+  st->free = memsum(MEM_FREE);
+  st->user = memsum(MEM_USER);
+  st->pagetable = memsum(MEM_PGTBL);
+  st->pipe = memsum(MEM_PIPE);
+  used = st->free + st->user + st->pagetable + st->pipe;
+  st->kernel = used < st->total ? st->total - used : 0;
+}
+
 //check number of free pages
 int
 freepagespace(void)
 {
-    int free_page = 0;
-    struct run *r = kmem.freelist;
-
-    //go through the freelist
-    for(r = kmem.freelist; r; r=r->next)
-    {
-        //for every free page, increase page counter
-        acquire(&kmem.lock);
-        free_page += 1;
-        release(&kmem.lock);
-    }
-
-    //return number of free pages
-    return free_page;
+    //sum of the per-CPU counts, no freelist walk
+    return memsum(MEM_FREE);
 }
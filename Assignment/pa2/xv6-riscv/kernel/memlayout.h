@@ -5,6 +5,7 @@
 //
 // 00001000 -- boot ROM, provided by qemu
 // 02000000 -- CLINT
+// 02F00000 -- ACLINT SSWI (with -machine virt,aclint=on)
 // 0C000000 -- PLIC
 // 10000000 -- uart0 
 // 10001000 -- virtio disk 
@@ -25,6 +26,12 @@
 #define VIRTIO0 0x10001000
 #define VIRTIO0_IRQ 1
 
+// ACLINT supervisor software interrupt device. writing 1 to a
+// hart's SETSSIP register raises a supervisor software interrupt
+// on that hart; it is used as an inter-processor interrupt.
+#define SSWI 0x02F00000L
+#define SSWI_SETSSIP(hart) (SSWI + 4*(hart))
+
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
 #define PLIC_PRIORITY (PLIC + 0x0)
@@ -0,0 +1,17 @@
+// Physical memory use, as returned by memstat(). Counts are pages.
+
+struct memstat {
+  uint64 total;      // pages kalloc() manages
+  uint64 free;
+  uint64 user;       // user memory
+  uint64 pagetable;  // page-table pages, the kernel's and processes'
+  uint64 pipe;       // pipe buffers
+  uint64 kernel;     // the rest: kernel stacks, trapframes, ...
+};
+
+// kinds of page the kernel keeps counts of (memcount()).
+#define MEM_FREE   0
+#define MEM_USER   1
+#define MEM_PGTBL  2
+#define MEM_PIPE   3
+#define NMEMKIND   4
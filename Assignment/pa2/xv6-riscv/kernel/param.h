@@ -1,5 +1,10 @@
-#define NPROC        64  // maximum number of processes
+// struct procs and their kernel stacks are created on demand but never
+// freed, so idle slots keep the memory of the most processes ever alive
+// at once: at worst NPROC stack pages plus NPROC/7 pages of struct proc,
+// about 2.3MB at 512. See proc.c.
+#define NPROC       512  // maximum number of processes, created on demand
 #define NCPU          8  // maximum number of CPUs
+#define NGROUP        8  // number of process groups
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
@@ -12,4 +17,12 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define TICKINTERVAL 100000 // time CSR cycles between timer interrupts
+#define BASESLICE    5000  // default EEVDF time slice (milliticks)
+#define MINSLICE     1000  // shortest slice setslice() accepts
+#define MAXSLICE     50000 // longest slice setslice() accepts
+#define MIGRATECOST  50    // milliticks a process stays cache-hot after running
+#define NRTPRIO      32    // real-time priorities, 0 (lowest) to NRTPRIO-1
+#define RTPERIOD     100000 // real-time throttling period (milliticks)
+#define RTRUNTIME    95000 // real-time run allowed per period while fair processes wait
 
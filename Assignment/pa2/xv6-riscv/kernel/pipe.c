@@ -7,6 +7,7 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "memstat.h"
 
 #define PIPESIZE 512
 
@@ -30,6 +31,7 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((pi = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memcount(MEM_PIPE, 1);
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
@@ -46,8 +48,10 @@ pipealloc(struct file **f0, struct file **f1)
   return 0;
 
  bad:
-  if(pi)
+  if(pi){
     kfree((char*)pi);
+    memcount(MEM_PIPE, -1);
+  }
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -69,6 +73,7 @@ pipeclose(struct pipe *pi, int writable)
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
     kfree((char*)pi);
+    memcount(MEM_PIPE, -1);
   } else
     release(&pi->lock);
 }
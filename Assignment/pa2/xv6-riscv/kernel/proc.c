@@ -4,30 +4,51 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "trace.h"
+#include "procinfo.h"
+#include "sched.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// struct procs are carved out of whole pages as they are
+// needed, up to NPROC of them, each with its own kernel stack.
+// They are never freed: an unused one waits on procfree, its
+// stack still mapped, for allocproc() to reuse. So a struct
+// proc pointer stays valid forever, as with a fixed table;
+// lock-free readers rely on that. The price is that idle slots
+// cost nothing only until first used: after a burst of
+// processes, the struct proc pages and stacks it needed stay
+// allocated (bounded by NPROC, see param.h). Returning a page
+// would need all its slots UNUSED, every lock-free reader off
+// them, and their stacks unmapped on every hart.
+struct proc *allproc;         // every struct proc, oldest first
+static struct proc *lastproc;
+static struct proc *procfree;
+static int nproc;             // struct procs created
+struct spinlock proc_lock;    // protects the above, and kernel stack mapping
+
+// bumped whenever a kernel stack is mapped; see scheduler().
+uint kstackgen;
 
 struct proc *initproc;
 
+struct group groups[NGROUP];
+
+// affinity mask allowing every CPU
+#define ALLCPUS ((1 << NCPU) - 1)
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// pid -> proc hash table, kept by allocproc() and freeproc(),
+// so that pid lookups need not scan proc[].
+#define NPIDHASH 64
+struct proc *pidhash[NPIDHASH];
+struct spinlock pidhash_lock;
+
 // ticks retrieved from trap.c
 extern uint ticks;
-// weight table given in PDF
-static const int weight_table[] = { /* 0 */    88761,  71755,  56483,  46273,  36291,
-                        /*  5 */    29154,  23254,  18705,  14949,  11916,
-                        /* 10 */    9548,   7620,   6100,   4904,   3906,
-                        /* 15 */    3121,   2501,   1991,   1586,   1277,
-                        /* 20 */    1024,   820,    655,    526,    423,
-                        /* 25 */    335,    272,    215,    172,    137,
-                        /* 30 */    110,    87,     70,     56,     45,
-                        /* 35 */    36,     29,     23,     18,     15
-                        };
-
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
@@ -41,35 +62,25 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl)
-{
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-  }
-}
-
 // initialize the proc table.
 void
 procinit(void)
 {
-  struct proc *p;
+  struct cpu *c;
+  int g;
   
+  initlock(&proc_lock, "proc_table");
   initlock(&pid_lock, "nextpid");
+  initlock(&pidhash_lock, "pidhash");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->state = UNUSED;
-      p->kstack = KSTACK((int) (p - proc));
+  for(c = cpus; c < &cpus[NCPU]; c++) {
+      initlock(&c->rqlock, "rq");
+      for(g = 0; g < NGROUP; g++)
+          c->rq[g].cpu = c;
+  }
+  for(g = 0; g < NGROUP; g++) {
+      groups[g].nice = 20;
+      groups[g].weight = weight_table[20];
   }
 }
 
@@ -117,7 +128,112 @@ allocpid()
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
+// Enter p, which has just been given its pid, in the pid hash.
+static void
+pidhash_add(struct proc *p)
+{
+  struct proc **head = &pidhash[(uint)p->pid % NPIDHASH];
+
+  acquire(&pidhash_lock);
+  p->pid_next = *head;
+  *head = p;
+  release(&pidhash_lock);
+}
+
+// Remove p from the pid hash, before its pid is cleared.
+static void
+pidhash_del(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pidhash_lock);
+  for(pp = &pidhash[(uint)p->pid % NPIDHASH]; *pp; pp = &(*pp)->pid_next){
+    if(*pp == p){
+      *pp = p->pid_next;
+      break;
+    }
+  }
+  release(&pidhash_lock);
+  p->pid_next = 0;
+}
+
+// Find the process with the given pid, and return it with
+// p->lock held, or 0 if there is none. Takes no other
+// process's lock. The caller must not hold pidhash_lock.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+
+  acquire(&pidhash_lock);
+  for(p = pidhash[(uint)pid % NPIDHASH]; p; p = p->pid_next)
+    if(p->pid == pid)
+      break;
+  release(&pidhash_lock);
+  if(p == 0)
+    return 0;
+
+  acquire(&p->lock);
+  // it may have exited and been freed in the meantime
+  if(p->pid != pid){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
+// Carve another page into UNUSED struct procs, each with a
+// newly mapped kernel stack, and put them on procfree.
+// Returns -1 if NPROC exist already or memory runs out.
+// proc_lock must be held.
+static int
+procgrow(void)
+{
+  char *page;
+  struct proc *p;
+  int i;
+
+  if(nproc >= NPROC || (page = kalloc()) == 0)
+    return -1;
+  memset(page, 0, PGSIZE);
+
+  for(i = 0; i < PGSIZE / sizeof(struct proc) && nproc < NPROC; i++){
+    p = (struct proc*)page + i;
+    // map a kernel stack, followed by an invalid guard page.
+    p->kstack = KSTACK(nproc);
+    if(kvmmapstack(p->kstack) < 0)
+      break;
+    nproc++;
+    initlock(&p->lock, "proc");
+    p->state = UNUSED;
+
+    // lock-free walkers of allproc see p once it is complete.
+    if(lastproc)
+      __atomic_store_n(&lastproc->allnext, p, __ATOMIC_RELEASE);
+    else
+      __atomic_store_n(&allproc, p, __ATOMIC_RELEASE);
+    lastproc = p;
+
+    p->freenext = procfree;
+    procfree = p;
+  }
+  if(i == 0){
+    kfree(page);
+    return -1;
+  }
+
+  // other harts flush their TLBs of the new stacks before running
+  // a process (see scheduler()); this one does it now.
+  __atomic_fetch_add(&kstackgen, 1, __ATOMIC_RELEASE);
+  sfence_vma();
+  return 0;
+}
+
+// Take an UNUSED proc off the free list, making more if
+// there is none.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
@@ -126,27 +242,36 @@ allocproc(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
+  acquire(&proc_lock);
+  if(procfree == 0 && procgrow() < 0){
+    release(&proc_lock);
+    return 0;
   }
-  return 0;
+  p = procfree;
+  procfree = p->freenext;
+  p->freenext = 0;
+  release(&proc_lock);
 
-found:
+  acquire(&p->lock);
   p->pid = allocpid();
+  pidhash_add(p);
   p->state = USED;
   p->nice = 20; //default priority value
+  p->group = 0;
+  p->policy = SCHED_NORMAL;
+  p->rtprio = 0;
+  p->cpu = 0;
+  p->affinity = ALLCPUS;
+  p->exec_start = 0;
   // initialize all variables
   p->weight = 1024;
   p->is_eligible = 0;
-  p->timeslice = 5000; // base slice is 5 ticks (5000 milliticks)
+  p->slice = BASESLICE; // base slice is 5 ticks (5000 milliticks)
+  p->timeslice = p->slice;
   p->runtime = 0;
   p->vruntime = 0;
-  p->vdeadline = ((uint64)5000 * 1024) / p->weight;
+  p->vdeadline = ((uint64)p->slice * 1024) / p->weight;
+  p->vlag = 0;
 
 
 
@@ -187,6 +312,8 @@ freeproc(struct proc *p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  if(p->pid)
+    pidhash_del(p);
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -195,12 +322,250 @@ freeproc(struct proc *p)
   p->xstate = 0;
   p->state = UNUSED;
   p->nice = 20;
+  p->group = 0;
+  p->policy = SCHED_NORMAL;
+  p->rtprio = 0;
+  p->affinity = ALLCPUS;
   p->weight = 1024;
   p->is_eligible = 0;
-  p->timeslice = 5000;
+  p->slice = BASESLICE;
+  p->timeslice = BASESLICE;
   p->runtime = 0;
   p->vruntime = 0;
   p->vdeadline = 0;
+  p->vlag = 0;
+
+  // back on the free list, for allocproc() to reuse
+  acquire(&proc_lock);
+  p->freenext = procfree;
+  procfree = p;
+  release(&proc_lock);
+}
+
+// Ask c to reschedule: interrupt it, so that it preempts its
+// running process or leaves wfi if it is idle.
+static void
+resched(struct cpu *c)
+{
+  c->need_resched = 1;
+  sendipi(c - cpus);
+}
+
+// Interrupt an idle hart, if there is one, so that it
+// steals queued work instead of waiting for a timer.
+static void
+kick_idle(void)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->idle){
+      sendipi(c - cpus);
+      return;
+    }
+  }
+}
+
+// is p in a real-time class?
+static int
+rt_task(struct proc *p)
+{
+  return p->policy != SCHED_NORMAL;
+}
+
+// number of fair processes queued on c, over all groups.
+static int
+nr_fair(struct cpu *c)
+{
+  int g, n = 0;
+
+  for(g = 0; g < NGROUP; g++)
+    n += c->rq[g].nr_running;
+  return n;
+}
+
+// number of processes queued on c, of either class. read
+// without c->rqlock; it is only a hint.
+static int
+nr_queued(struct cpu *c)
+{
+  return nr_fair(c) + c->rt.nr_running;
+}
+
+// number of RUNNING and RUNNABLE processes, for the load
+// averages. read without locks; it is only a hint.
+int
+nr_running(void)
+{
+  struct cpu *c;
+  int n = 0;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    n += nr_queued(c) + (c->proc != 0);
+  return n;
+}
+
+// take p off whichever of c's queues it is on, if any.
+// returns 1 if it was queued. c->rqlock must be held.
+static int
+dequeue_task(struct cpu *c, struct proc *p)
+{
+  if(p->on_rq){
+    rq_dequeue(&c->rq[p->group], p);
+    return 1;
+  }
+  if(p->on_rt){
+    rt_dequeue(&c->rt, p);
+    return 1;
+  }
+  return 0;
+}
+
+// Should real-time process p, queued on c, preempt what c runs?
+// Yes unless that is a real-time process of the same or higher
+// priority, or a fair one while c's real-time budget is used up.
+// c->rqlock must be held.
+static int
+rt_preempt(struct cpu *c, struct proc *p)
+{
+  int g;
+
+  if(c->rt.curr)
+    return p->rtprio > c->rt.curr->rtprio;
+  if(rt_throttled(&c->rt))
+    for(g = 0; g < NGROUP; g++)
+      if(c->rq[g].curr)
+        return 0;
+  return 1;
+}
+
+// may p run on c?
+static int
+cpu_allowed(struct proc *p, struct cpu *c)
+{
+  return (p->affinity & (1 << (c - cpus))) != 0;
+}
+
+// a CPU for p to move to when its affinity excludes its own:
+// an idle one if possible, else the least loaded allowed one.
+// affinity always allows some online CPU (see setaffinity()).
+static struct cpu*
+allowed_cpu(struct proc *p)
+{
+  struct cpu *c, *best = 0;
+  int n, least = 0;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->online || !cpu_allowed(p, c))
+      continue;
+    if(c->idle)
+      return c;
+    n = nr_queued(c);
+    if(best == 0 || n < least){
+      best = c;
+      least = n;
+    }
+  }
+  return best;
+}
+
+// Queue p, which is RUNNABLE but on no run queue, on c instead
+// of its own CPU, keeping its position relative to its peers,
+// and preempt c's current process if p should run first.
+// p->lock must be held.
+static void
+move_to(struct proc *p, struct cpu *c)
+{
+  struct runqueue *rq = &c->rq[p->group];
+  int preempt;
+
+  acquire(&c->rqlock);
+  if(rt_task(p)){
+    p->cpu = c - cpus;
+    rt_enqueue(&c->rt, p, 0);
+    preempt = rt_preempt(c, p);
+  } else {
+    rq_migrate(p, &cpus[p->cpu].rq[p->group], rq);
+    p->cpu = c - cpus;
+    rq_enqueue(rq, p);
+    preempt = rq_preempt(rq, p);
+  }
+  release(&c->rqlock);
+
+  if(preempt)
+    resched(c);
+}
+
+// the CPU a waking real-time process p should queue on: its
+// own if p would run there at once, else an allowed idle one,
+// else one running no real-time process, else its own anyway.
+// other CPUs are looked at without their locks, as hints.
+static struct cpu*
+rt_cpu(struct proc *p)
+{
+  struct cpu *c, *own = &cpus[p->cpu], *best = 0;
+  struct proc *curr;
+
+  if(cpu_allowed(p, own)){
+    curr = own->rt.curr;
+    if((curr == 0 || curr->rtprio < p->rtprio) && rt_top(&own->rt) < p->rtprio)
+      return own;
+  }
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->online || !cpu_allowed(p, c))
+      continue;
+    if(c->idle)
+      return c;
+    if(best == 0 && c->rt.curr == 0 && c->rt.nr_running == 0)
+      best = c;
+  }
+  if(best)
+    return best;
+  return cpu_allowed(p, own) ? own : allowed_cpu(p);
+}
+
+// Mark p RUNNABLE and put it on its CPU's run queue, placed at
+// its lag from the queue's average vruntime and with a fresh
+// vdeadline. If it should run before that CPU's current process,
+// preempt it; otherwise let an idle hart take p.
+// A real-time p goes to the tail of its priority's list on the
+// CPU where it would run soonest instead.
+// p->lock must be held.
+static void
+make_runnable(struct proc *p)
+{
+  struct cpu *c = &cpus[p->cpu];
+  struct runqueue *rq = &c->rq[p->group];
+  int preempt;
+
+  if(rt_task(p)){
+    p->state = RUNNABLE;
+    c = rt_cpu(p);
+    p->cpu = c - cpus;
+    acquire(&c->rqlock);
+    rt_enqueue(&c->rt, p, 0);
+    preempt = rt_preempt(c, p);
+    release(&c->rqlock);
+
+    if(preempt)
+      resched(c);
+    else
+      kick_idle();
+    return;
+  }
+
+  if(p->state == SLEEPING)
+    p->vlag = decay_lag(p->vlag, (r_time() - p->sleep_start) * 1000 / TICKINTERVAL);
+
+  p->state = RUNNABLE;
+  acquire(&c->rqlock);
+  preempt = rq_wake(rq, p);
+  release(&c->rqlock);
+
+  if(preempt)
+    resched(c);
+  else
+    kick_idle();
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -258,7 +623,7 @@ userinit(void)
   
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  make_runnable(p);
 
   release(&p->lock);
 }
@@ -283,6 +648,54 @@ growproc(int n)
   return 0;
 }
 
+// Add p to the front of a children or zombies list.
+// Caller must hold wait_lock.
+static void
+sibling_add(struct proc **list, struct proc *p)
+{
+  p->sibling_prev = 0;
+  p->sibling_next = *list;
+  if(*list)
+    (*list)->sibling_prev = p;
+  *list = p;
+}
+
+// Take p off the children or zombies list it is on.
+// Caller must hold wait_lock.
+static void
+sibling_del(struct proc **list, struct proc *p)
+{
+  if(p->sibling_prev)
+    p->sibling_prev->sibling_next = p->sibling_next;
+  else
+    *list = p->sibling_next;
+  if(p->sibling_next)
+    p->sibling_next->sibling_prev = p->sibling_prev;
+  p->sibling_next = 0;
+  p->sibling_prev = 0;
+}
+
+// Move the whole list *from to the front of *to, making
+// parent the parent of each process on it.
+// Caller must hold wait_lock.
+static void
+sibling_splice(struct proc **from, struct proc **to, struct proc *parent)
+{
+  struct proc *pp, *last = 0;
+
+  for(pp = *from; pp; pp = pp->sibling_next){
+    pp->parent = parent;
+    last = pp;
+  }
+  if(last == 0)
+    return;
+  last->sibling_next = *to;
+  if(*to)
+    (*to)->sibling_prev = last;
+  *to = *from;
+  *from = 0;
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -311,17 +724,28 @@ kfork(void)
 
   // EEVDF Rules
 
-  // child inherits parent process's vruntime, nice value and weight
+  // child inherits parent process's nice value, weight, slice,
+  // group and scheduling policy
   np->nice = p->nice;
+  np->group = p->group;
+  np->policy = p->policy;
+  np->rtprio = p->rtprio;
   np->weight = p->weight;
-  np->vruntime = p->vruntime;
+  np->slice = p->slice;
+  // rather than the parent's raw vruntime, the child starts with
+  // zero lag on the parent's run queue; make_runnable() places it
+  // at the queue's average vruntime
+  np->vlag = 0;
+  np->affinity = p->affinity;
+  np->cpu = p->cpu;
+  if(!cpu_allowed(np, &cpus[np->cpu]))
+    np->cpu = allowed_cpu(np) - cpus;
 
   // make sure actual runtime and remaining timeslice is set to default
   np->runtime = 0;  // runtime = 0
-  np->timeslice = 5000;  // timeslice = 5000 milliticks
+  np->timeslice = np->slice;  // a full slice
 
-  // vdeadline = vruntime + base timeslice (5000 milliticks) * 1024 / weight
-  np->vdeadline = np->vruntime + ((uint64)5000 * (uint64)1024) / (uint64)np->weight;
+  // vdeadline = vruntime + base timeslice, set by make_runnable()
   // eligibility set to 1
   np->is_eligible = 1;
 
@@ -343,28 +767,28 @@ kfork(void)
 
   acquire(&wait_lock);
   np->parent = p;
+  sibling_add(&p->children, np);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  make_runnable(np);
+  tracesched(TRACE_FORK, np);
   release(&np->lock);
 
   return pid;
 }
 
-// Pass p's abandoned children to init.
+// Pass p's abandoned children to init, exited ones
+// included, by splicing p's lists onto init's.
 // Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
-  struct proc *pp;
-
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
-  }
+  if(p->children == 0 && p->zombies == 0)
+    return;
+  sibling_splice(&p->children, &initproc->children, initproc);
+  sibling_splice(&p->zombies, &initproc->zombies, initproc);
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -397,6 +821,10 @@ kexit(int status)
   // Give any children to init.
   reparent(p);
 
+  // Move to the parent's exited children.
+  sibling_del(&p->parent->children, p);
+  sibling_add(&p->parent->zombies, p);
+
   // Parent might be sleeping in wait().
   wakeup(p->parent);
   
@@ -404,6 +832,7 @@ kexit(int status)
 
   p->xstate = status;
   p->state = ZOMBIE;
+  tracesched(TRACE_EXIT, p);
 
   release(&wait_lock);
 
@@ -418,39 +847,32 @@ int
 kwait(uint64 addr)
 {
   struct proc *pp;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
-          release(&pp->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // Exited children are queued on p->zombies.
+    if((pp = p->zombies) != 0){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      pid = pp->pid;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                              sizeof(pp->xstate)) < 0) {
         release(&pp->lock);
+        release(&wait_lock);
+        return -1;
       }
+      sibling_del(&p->zombies, pp);
+      freeproc(pp);
+      release(&pp->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(p->children == 0 || killed(p)){
       release(&wait_lock);
       return -1;
     }
@@ -460,6 +882,105 @@ kwait(uint64 addr)
   }
 }
 
+// Take the next process to run off c's run queues: the first
+// real-time process of the highest priority, unless c has used
+// up its real-time budget and fair processes wait; else the one
+// the chosen group would run next. Returns 0 if nothing is
+// queued. c->rqlock must be held.
+static struct proc*
+pick_next(struct cpu *c)
+{
+  struct proc *p;
+
+  if(c->rt.nr_running && !(rt_throttled(&c->rt) && nr_fair(c))){
+    p = rt_pick(&c->rt);
+    rt_dequeue(&c->rt, p);
+    return p;
+  }
+
+  return rq_pick_next(c);
+}
+
+// May p, queued on another CPU, move to c? Not if its affinity
+// excludes c, nor while it is still cache-hot where it last
+// ran: less than MIGRATECOST milliticks ago. Then *retry is
+// lowered to when p turns cold.
+// p's CPU's rqlock must be held.
+static int
+can_migrate(struct proc *p, struct cpu *c, uint64 *retry)
+{
+  uint64 cold;
+
+  if(!cpu_allowed(p, c))
+    return 0;
+
+  // a queued process is not running, so exec_start is when
+  // it last stopped.
+  cold = p->exec_start + (uint64)MIGRATECOST * TICKINTERVAL / 1000;
+  if(p->exec_start != 0 && r_time() < cold){
+    if(*retry == 0 || cold < *retry)
+      *retry = cold;
+    return 0;
+  }
+  return 1;
+}
+
+// Take a process off the busiest other CPU's run queues that
+// may move to c, so that idle c can run it instead: the one
+// with the earliest deadline among those can_migrate() allows.
+// If none can move only because they are cache-hot, sets
+// c->balance_at to when to try again.
+// Sets *from to the CPU it was taken from.
+// Returns 0 if no other CPU has a process for c.
+static struct proc*
+steal(struct cpu *c, struct cpu **from)
+{
+  struct cpu *busiest, *other;
+  struct proc *p = 0;
+  int n, most, g, tried = 0;
+
+  c->balance_at = 0;
+  for(;;){
+    // the busiest CPU not tried yet
+    busiest = 0;
+    most = 0;
+    for(other = cpus; other < &cpus[NCPU]; other++){
+      if(other == c || (tried & (1 << (other - cpus))))
+        continue;
+      n = nr_queued(other);
+      if(n > most){
+        busiest = other;
+        most = n;
+      }
+    }
+    if(busiest == 0)
+      return 0;
+    tried |= 1 << (busiest - cpus);
+
+    acquire(&busiest->rqlock);
+    // a waiting real-time process moves even if cache-hot
+    for(p = rt_pick(&busiest->rt); p; p = rt_next(&busiest->rt, p))
+      if(cpu_allowed(p, c))
+        break;
+    if(p){
+      rt_dequeue(&busiest->rt, p);
+    } else {
+      for(g = 0; g < NGROUP && p == 0; g++)
+        for(p = rq_first(&busiest->rq[g]); p; p = rq_next(p))
+          if(can_migrate(p, c, &c->balance_at))
+            break;
+      if(p)
+        rq_dequeue(&busiest->rq[p->group], p);
+    }
+    release(&busiest->rqlock);
+
+    if(p){
+      *from = busiest;
+      return p;
+    }
+  }
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -472,8 +993,11 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  struct cpu *from;
 
   c->proc = 0;
+  c->online = 1;
+  cpuacct(CPU_KERNEL);  // start charging this cpu's time
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
@@ -510,108 +1034,137 @@ scheduler(void)
 
     // EEVDF Scheduling Rules
 
-    // process to be selected
-    struct proc *selected_p = 0;
+    // take the eligible process with the earliest vdeadline in
+    // the eligible group with the earliest vdeadline off this
+    // CPU's run queues. p->lock is not held here, but a queued
+    // process can only leave RUNNABLE through a dequeue.
+    //
+    // count as idle from before the look, so that a process made
+    // runnable after it finds nothing sees this hart idle and
+    // kicks it out of wfi. the fence pairs with the one in the
+    // release() of the rqlock the process was queued under.
+    c->idle = 1;
+    __sync_synchronize();
+    acquire(&c->rqlock);
+    p = pick_next(c);
+    release(&c->rqlock);
+    from = c;
 
-    // -1 = infinity (max value of uint64)
-    uint64 min_vdeadline = -1;
-    uint64 min_vruntime = -1;
-    // will be used to calculate eligibility
-    int total_weight = 0;
-    uint64 weighted_vruntime = 0;
+    // nothing queued here; try to take work from another CPU
+    if(p == 0)
+      p = steal(c, &from);
+    if(p)
+      c->idle = 0;
 
-    // for loop to find minimum vruntime and total weight of all runnable processes
-    for(p = proc; p < &proc[NPROC]; p++)
+    // run the selected process
+    if(p)
     {
         acquire(&p->lock);
-        // make sure process is runnable
-        if(p->state == RUNNABLE)
+        // setaffinity() excluded this CPU after p was picked:
+        // queue it on one it allows and pick again. its vruntime
+        // is still relative to the queue it was taken from
+        if(p->state == RUNNABLE && !cpu_allowed(p, c))
         {
-            //if process has the smallest vruntime, update minimum vruntime
-            if(min_vruntime == -1 || p->vruntime < min_vruntime)
-            {
-                min_vruntime = p->vruntime;
-            }
-            // get the sum of the runnable processes' weights
-            total_weight += p->weight;
+            p->cpu = from - cpus;
+            move_to(p, allowed_cpu(p));
+            release(&p->lock);
+            continue;
         }
-        release(&p->lock);
-    }
-
-
-    // check if runnable process exists (min_vruntime should not be -1)
-    // calculate the weighted sum of all vruntime of the runnable processes
-    if(min_vruntime != -1)
-    {
-        // for loop to calculate the weighted sum of all vruntime
-        for(p = proc; p < &proc[NPROC]; p++)
+        struct runqueue *rq = &c->rq[p->group];
+        // migrated: rebase onto this CPU's vruntime baseline
+        if(from != c)
+            rq_migrate(p, &from->rq[p->group], rq);
+        // setaffinity() may have retargeted it in the meantime
+        p->cpu = c - cpus;
+        if(p->state == RUNNABLE)
         {
-            acquire(&p->lock);
-            // make sure process is runnable
-            if(p->state == RUNNABLE)
+            // it still counts towards this queue's average while
+            // it runs; a real-time process has no average
+            acquire(&c->rqlock);
+            if(rt_task(p))
+                c->rt.curr = p;
+            else
+                rq_attach(rq, p);
+            release(&c->rqlock);
+
+            // switch to the chosen process
+            p->is_eligible = 1;
+            p->state = RUNNING;
+            p->exec_start = r_time();
+            c->need_resched = 0;
+            c->proc = p;
+            // its kernel stack may have been mapped since this
+            // hart last flushed its TLB
+            uint gen = __atomic_load_n(&kstackgen, __ATOMIC_ACQUIRE);
+            if(c->kstackgen != gen)
             {
-                // weighted vruntime = (current process' vruntime - minimum vruntime) * current process' weight
-                weighted_vruntime += (uint64)(p->vruntime - min_vruntime) * (uint64)p->weight;
+                sfence_vma();
+                c->kstackgen = gen;
             }
-            release(&p->lock);
-        }
-        
+            // interrupt it when its time slice runs out
+            settimer();
+            tracesched(TRACE_SWITCHIN, p);
+            swtch(&c->context, &p->context);
+            // process is done running now, it should have changed its p->state before coming back
 
-        // for loop to check eligibility
-        for(p = proc; p < &proc[NPROC]; p++)
-        {
-            acquire(&p->lock);
-            // check if process is runnable
-            if(p->state == RUNNABLE)
-            {
-                // set eligibility flag of runnable process
-                // weighted sum >= (current runtime - minimum runtime) * total weight
-                p->is_eligible = (weighted_vruntime >= (uint64)(p->vruntime - min_vruntime) * (uint64)total_weight);
-                
+            c->proc = 0;
 
-                // check if current process is eligible
-                if(p->is_eligible)
+            // charge it for the rest of its run, then requeue it
+            // if it yielded; if it slept or exited, it leaves the
+            // queue until wakeup()
+            int stay = p->state == RUNNABLE && cpu_allowed(p, c);
+            acquire(&c->rqlock);
+            if(rt_task(p))
+            {
+                rt_charge(&c->rt, update_runtime(p));
+                c->rt.curr = 0;
+                if(p->timeslice <= 0)
                 {
-                    // check if current eligible process has the earliest virtual deadline
-                    // selected_p is empty (0) or current deadline is earlier
-                    if(selected_p == 0 || p->vdeadline < min_vdeadline)
-                    {
-                        // update minimum deadline and the currently selected process
-                        min_vdeadline = p->vdeadline;
-                        selected_p = p;
-                    }
+                    // a round-robin process used up its slice: to
+                    // the back of its list. otherwise it was
+                    // preempted and keeps its place at the front
+                    int expired = p->policy == SCHED_RR;
+                    p->timeslice = p->slice;
+                    if(stay)
+                        rt_enqueue(&c->rt, p, !expired);
                 }
+                else if(stay)
+                    rt_enqueue(&c->rt, p, 1);
             }
-            // make sure all non-runnable processes are set to non-eligible
             else
             {
-                p->is_eligible = 0;
+                rq_update_curr(rq, p);
+                if(p->state == SLEEPING)
+                {
+                    // remember its lag, to place it again on wakeup
+                    rq_sleep(rq, p);
+                    p->sleep_start = r_time();
+                }
+                // requeue before detaching, so that its group does
+                // not go inactive on this CPU in between
+                if(stay)
+                    rq_enqueue(rq, p);
+                rq_detach(rq, p);
             }
-            release(&p->lock);
-        }
-    }
-
-
-    // run the selected process
-    if(selected_p)
-    {
-        acquire(&selected_p->lock);
-        if(selected_p->state == RUNNABLE)
-        {
-            // switch to the chosen process
-            selected_p->state = RUNNING;
-            c->proc = selected_p;
-            swtch(&c->context, &selected_p->context);
-            // process is done running now, it should have changed its p->state before coming back
+            release(&c->rqlock);
 
-            c->proc = 0;
+            // its affinity changed while it ran: move it away
+            if(p->state == RUNNABLE && !stay)
+                move_to(p, allowed_cpu(p));
+            tracesched(TRACE_SWITCHOUT, p);
         }
-        release(&selected_p->lock);
+        release(&p->lock);
     }
     else
     {
-        // nothing to run; stop running until an interrupt
+        // nothing to run; stop running until an interrupt.
+        // no timer interrupt unless a pause() sleeper is due;
+        // make_runnable() interrupts idle harts when work arrives
+        settimer();
+        cpuacct(CPU_IDLE);
         asm volatile("wfi");
+        cpuacct(CPU_KERNEL);
+        c->idle = 0;
     }
   }
 }
@@ -649,6 +1202,7 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
+  // scheduler() puts it back on the run queue.
   p->state = RUNNABLE;
   sched();
   release(&p->lock);
@@ -729,21 +1283,19 @@ wakeup(void *chan)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  for(p = allproc; p; p = p->allnext) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         
         // EEVDF Rules
-        // vruntime and nice value will remain the same as before sleeping
-        // default timeslice (5000 milliticks)
-        p->timeslice = 5000;
-        // vdeadline and eligibility recalculated
-        p->vdeadline = p->vruntime + ((uint64)5000 * (uint64)1024) / (uint64)p->weight;
-        p->is_eligible = 1;
-        
-
-        p->state = RUNNABLE;
+        // nice value will remain the same as before sleeping;
+        // vruntime is placed to keep the lag it slept with
+        // full requested timeslice
+        p->timeslice = p->slice;
+        // vdeadline and eligibility recalculated in make_runnable()
+        make_runnable(p);
+        tracesched(TRACE_WAKEUP, p);
       }
       release(&p->lock);
     }
@@ -758,20 +1310,16 @@ kkill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    make_runnable(p);
+    tracesched(TRACE_WAKEUP, p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -841,7 +1389,7 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allproc; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -860,22 +1408,18 @@ getpname(int pid)
 {
     struct proc *p;
 
-    //for loop to find pid
-    for(p = proc; p < &proc[NPROC]; p++)
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
     {
-        acquire(&p->lock);
-        //if pid found, print name
-        //return 0(success)
-        if(p->pid == pid)
-        {
-            printf("%s\n", p->name);
-            release(&p->lock);
-            return 0;
-        }
-        release(&p->lock);
+        //not found, return -1
+        return -1;
     }
-    //return -1 error
-    return -1;
+
+    //if pid found, print name
+    //return 0(success)
+    printf("%s\n", p->name);
+    release(&p->lock);
+    return 0;
 }
 
 //get nice value of the specified pid
@@ -884,22 +1428,19 @@ int
 getnice(int pid)
 {
     struct proc *p;
+    int nice;
 
-    //find pid in list
-    //if found, return nice value
-    for(p = proc; p < &proc[NPROC]; p++)
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
     {
-        acquire(&p->lock);
-        if(p->pid == pid)
-        {
-            release(&p->lock);
-            return p->nice;
-        }
-        release(&p->lock);
+        //not found, return -1
+        return -1;
     }
 
-    //if not found, return -1
-    return -1;
+    //return nice value
+    nice = p->nice;
+    release(&p->lock);
+    return nice;
 }
 
 //set nice value of the specified pid
@@ -915,34 +1456,404 @@ setnice(int pid, int value)
         return -1;
     }
 
-    //find pid in list
-    //if found, return nice value
-    for(p = proc; p < &proc[NPROC]; p++)
-    {    
-        acquire(&p->lock); 
-        //if process id = inputted pid
-        if(p->pid == pid)
-        {
-            // return 0 (success)
-            p->nice = value;
-            
-            // EEVDF Rules
-            
-            // Update weight based on nice value and weight table
-            p->weight = weight_table[p->nice];
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    // EEVDF Rules
+
+    // weight and vdeadline are run queue keys, and weight
+    // is part of the queue's average, so take a RUNNABLE
+    // process off the queue around the update. a RUNNING one
+    // is first charged for its time at its old weight, then
+    // reweighted in place so that its group stays active
+    struct cpu *c = &cpus[p->cpu];
+    struct runqueue *rq = &c->rq[p->group];
+    acquire(&c->rqlock);
+    int queued = p->on_rq;
+    int running = (rq->curr == p);
+    if(queued)
+        rq_dequeue(rq, p);
+    else if(running)
+        rq_update_curr(rq, p);
+
+    // Update weight based on nice value and weight table
+    p->nice = value;
+    if(running)
+        rq_reweight_curr(rq, p, weight_table[p->nice]);
+    else
+        p->weight = weight_table[p->nice];
 
-            // Calculate vdeadline
-            // vdeadline = vruntime + base time slice (5000 milliticks) * 1024 / weight
-            p->vdeadline = p->vruntime + ((uint64)5000 * (uint64)1024) / (uint64)p->weight;
+    // Calculate vdeadline
+    // vdeadline = vruntime + requested time slice * 1024 / weight
+    p->vdeadline = p->vruntime + vscale(p, p->slice);
 
-            release(&p->lock);
-            return 0;
-        }
+    if(queued)
+        rq_enqueue(rq, p);
+    release(&c->rqlock);
+
+    // return 0 (success)
+
+    release(&p->lock);
+    return 0;
+}
+
+//get requested time slice (milliticks) of the specified pid
+//success: slice; error: -1
+int
+getslice(int pid)
+{
+    struct proc *p;
+    int slice;
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    slice = p->slice;
+    release(&p->lock);
+    return slice;
+}
+
+//request a time slice (milliticks) for the specified pid
+//a shorter slice gives earlier vdeadlines: more frequent but
+//shorter runs. a longer one favours throughput. nice still
+//decides the share of CPU time either way.
+//success: 0; error: -1
+int
+setslice(int pid, int value)
+{
+    struct proc *p;
+
+    //make sure value in range MINSLICE~MAXSLICE
+    if(value < MINSLICE || value > MAXSLICE)
+    {
+        return -1;
+    }
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    p->slice = value;
+
+    // vdeadline is a run queue key: requeue a RUNNABLE process.
+    // charge a RUNNING one up to now, so that what is left of
+    // its timeslice counts from now
+    struct cpu *c = &cpus[p->cpu];
+    struct runqueue *rq = &c->rq[p->group];
+    acquire(&c->rqlock);
+    int queued = p->on_rq;
+    int running = p->state == RUNNING;
+    if(queued)
+        rq_dequeue(rq, p);
+    else if(running && rt_task(p))
+        rt_charge(&c->rt, update_runtime(p));
+    else if(running)
+        rq_update_curr(rq, p);
+
+    // don't let a running process keep more than its new slice
+    if(p->timeslice > value)
+        p->timeslice = value;
+
+    // vdeadline = vruntime + requested time slice * 1024 / weight
+    p->vdeadline = p->vruntime + vscale(p, p->slice);
+
+    if(queued)
+        rq_enqueue(rq, p);
+    release(&c->rqlock);
+
+    // its timer interrupt was programmed for the old slice; the
+    // tick that a software interrupt is handled as re-arms it
+    if(running)
+    {
+        if(c == mycpu())
+            settimer();
+        else
+            sendipi(c - cpus);
+    }
+
+    release(&p->lock);
+    return 0;
+}
+
+//get process group of the specified pid
+//success: group; error: -1
+int
+getgroup(int pid)
+{
+    struct proc *p;
+    int group;
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    group = p->group;
+    release(&p->lock);
+    return group;
+}
+
+//move the specified pid into a process group
+//its children inherit the group from then on
+//success: 0; error: -1
+int
+setgroup(int pid, int group)
+{
+    struct proc *p;
+
+    //make sure group in range 0~NGROUP-1
+    if(group < 0 || group >= NGROUP)
+    {
+        return -1;
+    }
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    // a RUNNABLE or RUNNING process moves to the new group's
+    // queue on its CPU; a sleeping one is placed there on wakeup
+    struct cpu *c = &cpus[p->cpu];
+    struct runqueue *from = &c->rq[p->group];
+    struct runqueue *to = &c->rq[group];
+    acquire(&c->rqlock);
+    int queued = p->on_rq;
+    int running = (from->curr == p);
+    if(queued)
+        rq_dequeue(from, p);
+    else if(running)
+        rq_detach(from, p);
+
+    // keep its position relative to its new peers
+    if(queued || running)
+        rq_migrate(p, from, to);
+    p->group = group;
+
+    if(queued)
+        rq_enqueue(to, p);
+    else if(running)
+        rq_attach(to, p);
+    release(&c->rqlock);
+
+    release(&p->lock);
+    return 0;
+}
+
+//set nice value of a process group, from which its weight
+//is derived. the group's processes share that weight.
+//the scheduler reads groups[] without a lock; the new weight
+//takes effect at its next pick on each CPU.
+//success: 0; error: -1
+int
+setgroupnice(int group, int value)
+{
+    //make sure group and value in range
+    if(group < 0 || group >= NGROUP || value < 0 || value > 39)
+    {
+        return -1;
+    }
+
+    groups[group].nice = value;
+    groups[group].weight = weight_table[value];
+    return 0;
+}
+
+//get CPU affinity mask of the specified pid
+//success: mask; error: -1
+int
+getaffinity(int pid)
+{
+    struct proc *p;
+    int mask;
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    mask = p->affinity;
+    release(&p->lock);
+    return mask;
+}
+
+//restrict the specified pid to the CPUs in mask (bit i = hart i)
+//its children inherit the mask
+//success: 0; error: -1
+int
+setaffinity(int pid, int mask)
+{
+    struct proc *p;
+    struct cpu *c;
+    int online = 0;
+
+    //make sure mask allows at least one running CPU
+    for(c = cpus; c < &cpus[NCPU]; c++)
+        if(c->online)
+            online |= 1 << (c - cpus);
+    if((mask & online) == 0)
+    {
+        return -1;
+    }
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    // queue walkers (steal()) read the mask under the rqlock
+    c = &cpus[p->cpu];
+    acquire(&c->rqlock);
+    p->affinity = mask & ALLCPUS;
+    int queued = p->on_rq || p->on_rt;
+    int running = (c->rq[p->group].curr == p || c->rt.curr == p);
+    if(!cpu_allowed(p, c) && queued)
+        dequeue_task(c, p);
+    release(&c->rqlock);
+
+    if(!cpu_allowed(p, c))
+    {
+        if(queued)
+            move_to(p, allowed_cpu(p));
+        else if(running)
+            // scheduler() moves it once it is switched out
+            resched(c);
+        else
+            // placed on an allowed CPU when it wakes up, or
+            // moved by scheduler() if it is about to run
+            p->cpu = allowed_cpu(p) - cpus;
+    }
+
+    release(&p->lock);
+    return 0;
+}
+
+//get scheduling policy of the specified pid (sched.h),
+//and its real-time priority into *prio if prio isn't 0
+//success: policy; error: -1
+int
+getscheduler(int pid, uint64 prio)
+{
+    struct proc *p;
+    int policy, rtprio;
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    policy = p->policy;
+    rtprio = p->rtprio;
+    release(&p->lock);
+
+    if(prio != 0 && copyout(myproc()->pagetable, prio, (char *)&rtprio, sizeof(rtprio)) < 0)
+        return -1;
+    return policy;
+}
+
+//set scheduling policy (sched.h) of the specified pid
+//SCHED_FIFO and SCHED_RR processes run before any SCHED_NORMAL
+//one, highest prio (0~NRTPRIO-1) first; see rt.c
+//success: 0; error: -1
+int
+setscheduler(int pid, int policy, int prio)
+{
+    struct proc *p;
+
+    //make sure policy and prio in range
+    if(policy != SCHED_NORMAL && policy != SCHED_FIFO && policy != SCHED_RR)
+    {
+        return -1;
+    }
+    if(policy == SCHED_NORMAL)
+        prio = 0;
+    else if(prio < 0 || prio >= NRTPRIO)
+    {
+        return -1;
+    }
+
+    //find pid through the pid hash, with p->lock held
+    if((p = findproc(pid)) == 0)
+    {
+        //not found, return -1
+        return -1;
+    }
+
+    // nothing to do for a fair process staying fair
+    if(!rt_task(p) && policy == SCHED_NORMAL)
+    {
         release(&p->lock);
+        return 0;
     }
 
-    //if not found, return -1
-    return -1;
+    // take it out of its class around the change
+    struct cpu *c = &cpus[p->cpu];
+    struct runqueue *rq = &c->rq[p->group];
+    acquire(&c->rqlock);
+    int queued = dequeue_task(c, p);
+    int running = (rq->curr == p || c->rt.curr == p);
+    if(running && rt_task(p))
+    {
+        rt_charge(&c->rt, update_runtime(p));
+        c->rt.curr = 0;
+    }
+    else if(running)
+    {
+        rq_update_curr(rq, p);
+        rq_detach(rq, p);
+    }
+
+    // joining the fair class: start with zero lag
+    if(rt_task(p) && policy == SCHED_NORMAL)
+        p->vlag = 0;
+    p->policy = policy;
+    p->rtprio = prio;
+
+    if(running && rt_task(p))
+        c->rt.curr = p;
+    else if(running)
+    {
+        p->vruntime = rq_avg_vruntime(rq);
+        p->vdeadline = p->vruntime + vscale(p, p->slice);
+        rq_attach(rq, p);
+    }
+    else if(queued && rt_task(p))
+        rt_enqueue(&c->rt, p, 0);
+    else if(queued)
+    {
+        rq_place(rq, p);
+        p->vdeadline = p->vruntime + vscale(p, p->slice);
+        rq_enqueue(rq, p);
+    }
+    release(&c->rqlock);
+
+    // let its CPU choose again under the new policy
+    if(queued || running)
+        resched(c);
+
+    release(&p->lock);
+    return 0;
 }
 
 //ps: print out pid list, if 0 is inputted, print entire list
@@ -960,35 +1871,30 @@ ps(int pid)
     };
     
     struct proc *p;
-    int pid_exists = 0; //boolean to check if pid exists
+    struct proc *first = allproc, *last = 0; //range to print
 
-    //check whether pid exists or is 0
-    for(p = proc; p < &proc[NPROC]; p++)
+    //a single pid: find it through the pid hash
+    if(pid != 0)
     {
-        acquire(&p->lock);
-
-        if(p->pid == pid)
+        //if pid does not exist, exit function
+        if((p = findproc(pid)) == 0)
         {
-            pid_exists = 1;
+            return;
         }
         release(&p->lock);
-    }
-    if(pid == 0)
-    {
-        pid_exists = 1;
-    }
-
-    //if pid does not exist, exit function
-    if(pid_exists == 0)
-    {
-        return;
+        first = p;
+        last = p->allnext;
     }
     
+    acquire(&tickslock);
+    tickupdate();
+    release(&tickslock);
+
     //list template
     printf("name\tpid\tstate\t\tpriority\truntime/weight\truntime\t\tvruntime\tvdeadline\tis_eligible\ttick %d\n", ticks * 1000);
 
     //print process info
-    for(p = proc; p < &proc[NPROC]; p++)
+    for(p = first; p != last; p = p->allnext)
     {
         acquire(&p->lock);
         if(pid == 0 || p->pid == pid)
@@ -1004,6 +1910,20 @@ ps(int pid)
             uint64 runtime_weight = (p->runtime / (uint64)1000) * (uint64)1024;
             runtime_weight /= p->weight;
 
+            // eligibility is only tracked for queued processes,
+            // so refresh the flag here
+            if(p->state == RUNNABLE)
+            {
+                struct cpu *c = &cpus[p->cpu];
+                acquire(&c->rqlock);
+                p->is_eligible = rq_eligible(&c->rq[p->group], p);
+                release(&c->rqlock);
+            }
+            else if(p->state != RUNNING)
+            {
+                p->is_eligible = 0;
+            }
+
             // eligibility flag to string
             char *eligible = p->is_eligible ? "true" : "false";
 
@@ -1017,6 +1937,87 @@ ps(int pid)
 
 }
 
+//copy a record of each process in use, up to n, to user
+//address addr: the table is copied out a page of records at a
+//time, so one copyout() covers PGSIZE / sizeof(struct procinfo)
+//processes (64).
+//success: number of records; error: -1
+int
+procsnap(uint64 addr, int n)
+{
+    struct proc *p;
+    struct procinfo *buf, *r;
+    int max = PGSIZE / sizeof(struct procinfo);
+    int i = 0, copied = 0;
+
+    if((buf = (struct procinfo *)kalloc()) == 0)
+    {
+        return -1;
+    }
+
+    for(p = allproc; p && copied + i < n; p = p->allnext)
+    {
+        acquire(&p->lock);
+        if(p->state == UNUSED)
+        {
+            release(&p->lock);
+            continue;
+        }
+
+        r = &buf[i];
+        r->pid = p->pid;
+        r->weight = p->weight;
+        r->runtime = p->runtime;
+        // a running process is only charged at its next tick
+        if(p->state == RUNNING)
+            r->runtime += (r_time() - p->exec_start) * 1000 / TICKINTERVAL;
+        r->vruntime = p->vruntime;
+        r->vdeadline = p->vdeadline;
+        r->sz = p->sz;
+        r->state = p->state;
+        r->nice = p->nice;
+        r->cpu = p->cpu;
+
+        // eligibility is only tracked for queued processes,
+        // so refresh the flag here, as ps() does
+        if(p->state == RUNNABLE)
+        {
+            struct cpu *c = &cpus[p->cpu];
+            acquire(&c->rqlock);
+            p->is_eligible = rq_eligible(&c->rq[p->group], p);
+            release(&c->rqlock);
+        }
+        else if(p->state != RUNNING)
+        {
+            p->is_eligible = 0;
+        }
+        r->eligible = p->is_eligible;
+        safestrcpy(r->name, p->name, sizeof(r->name));
+        release(&p->lock);
+
+        //copy out a full page of records
+        if(++i == max)
+        {
+            if(copyout(myproc()->pagetable, addr + copied * sizeof(*buf), (char *)buf, i * sizeof(*buf)) < 0)
+            {
+                kfree(buf);
+                return -1;
+            }
+            copied += i;
+            i = 0;
+        }
+    }
+
+    if(i > 0 && copyout(myproc()->pagetable, addr + copied * sizeof(*buf), (char *)buf, i * sizeof(*buf)) < 0)
+    {
+        kfree(buf);
+        return -1;
+    }
+    copied += i;
+    kfree(buf);
+    return copied;
+}
+
 //return available memory in bytes
 int
 meminfo()
@@ -1034,7 +2035,6 @@ int
 waitpid(int pid)
 {
     struct proc *p;
-    int pid_found;
     //current_p = current process
     struct proc *current_p = myproc();
    
@@ -1042,46 +2042,34 @@ waitpid(int pid)
     //infinite loop
     for(;;)
     {
-        pid_found = 0;
-
-        //Scan process table for pid and check if it's a child
-        for(p = proc; p < &proc[NPROC]; p++)
+        //find pid through the pid hash; it must be a child
+        //of the current process
+        p = findproc(pid);
+        if(p != 0 && p->parent != current_p)
         {
-            acquire(&p->lock);
-            //check if this is the right process
-            if(p->pid != pid)
-            {
-                release(&p->lock);
-                continue;
-            }
-
-            pid_found = 1;
-
-            //once process found, check if parent of found child is the current process
-            if(p->parent != current_p)
-            {
-                release(&p->lock);
-                release(&wait_lock);
-                return -1;
-            }
-           
-            //process is child of current process
-            //check for zombie state
-            if(p->state == ZOMBIE)
-            {
-                // free memory
-                freeproc(p);
-                release(&p->lock);
-                release(&wait_lock);
-                //return 0
-                return 0;
-            }
             release(&p->lock);
+            p = 0;
+        }
 
+        //process is child of current process
+        //check for zombie state
+        if(p != 0 && p->state == ZOMBIE)
+        {
+            // free memory
+            sibling_del(&current_p->zombies, p);
+            freeproc(p);
+            release(&p->lock);
+            release(&wait_lock);
+            //return 0
+            return 0;
+        }
+        if(p != 0)
+        {
+            release(&p->lock);
         }
 
         //if no such child or current process was killed, return error -1
-        if(!pid_found || current_p->killed)
+        if(p == 0 || current_p->killed)
         {
             release(&wait_lock);
             return -1;
@@ -1091,3 +2079,23 @@ waitpid(int pid)
 
     }
 }
+
+// charge the running process p for the time since its
+// runtime was last updated, as measured by the time CSR.
+// updates runtime, timeslice and vruntime (all in milliticks).
+// p->lock must be held, and p must be detached from its
+// run queue's sums since vruntime changes (see rq_update_curr()).
+// returns the milliticks charged.
+uint64
+update_runtime(struct proc *p)
+{
+    uint64 delta;
+
+    // TICKINTERVAL cycles make 1000 milliticks. only whole
+    // milliticks are charged; the remainder carries over.
+    delta = (r_time() - p->exec_start) * 1000 / TICKINTERVAL;
+    p->exec_start += delta * TICKINTERVAL / 1000;
+
+    charge(p, delta);
+    return delta;
+}
@@ -18,12 +18,72 @@ struct context {
   uint64 s11;
 };
 
+// EEVDF run queue of one process group on one cpu: a red-black
+// tree of RUNNABLE processes, ordered by vdeadline, and the
+// group's own entity among the cpu's groups (see eevdf.c).
+// the cpu's rqlock must be held when using these.
+struct runqueue {
+  struct cpu *cpu;            // cpu this queue belongs to.
+  struct proc *root;          // root of the tree, or null if empty.
+  struct proc *curr;          // process running on this queue's cpu, or null.
+  int nr_running;             // number of queued processes.
+  int total_weight;           // sum of weights of queued processes and curr.
+  long weighted_vruntime;     // sum of weight * (vruntime - min_vruntime), ditto.
+  uint64 min_vruntime;        // monotonic vruntime baseline of this queue.
+
+  // the group's entity; active while total_weight is non-zero.
+  int gweight;                // group's share of its weight on this cpu.
+  uint64 ginv_weight;         // 2^32 / gweight, see gvscale().
+  uint64 gvruntime;           // group's virtual runtime on this cpu.
+  uint64 gvdeadline;          // group's virtual deadline on this cpu.
+  long gvlag;                 // group's lag when it last went inactive.
+};
+
+// Real-time run queue: FIFO lists of RUNNABLE real-time
+// processes, one per priority (see rt.c).
+// the cpu's rqlock must be held when using these.
+struct rtqueue {
+  struct proc *head[NRTPRIO]; // first and last queued process of each priority.
+  struct proc *tail[NRTPRIO];
+  uint bitmap;                // bit i set if head[i] is non-empty.
+  int nr_running;             // number of queued processes.
+  struct proc *curr;          // real-time process running on this cpu, or null.
+  uint64 period_start;        // r_time() the current throttling period began.
+  uint64 runtime;             // real-time milliticks run in this period.
+};
+
+// Process group: its processes share one weight.
+struct group {
+  int nice;                   // priority (nice value) of the group
+  int weight;                 // weight value (derived from nice value)
+};
+
+extern struct group groups[NGROUP];
+
+// weight of each nice value (eevdf.c)
+extern const int weight_table[];
+
+// what a cpu's time is charged to (cpustat.c).
+enum cpumode { CPU_KERNEL, CPU_USER, CPU_IDLE };
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct spinlock rqlock;     // protects rq[] and gvclock.
+  struct runqueue rq[NGROUP]; // each group's RUNNABLE processes waiting for this cpu.
+  struct rtqueue rt;          // RUNNABLE real-time processes waiting for this cpu.
+  uint64 gvclock;             // average group vruntime when last computed.
+  int need_resched;           // Preempt the running process at the next trap.
+  int idle;                   // Waiting in scheduler() with nothing to run.
+  int online;                 // Has entered scheduler().
+  uint64 balance_at;          // r_time() to retry stealing at when idle, or 0.
+  uint kstackgen;             // kstackgen (proc.c) when this cpu last flushed its TLB.
+  int acctmode;               // enum cpumode this cpu is charging time to.
+  uint64 acctstart;           // r_time() acctmode was entered, or 0 before the first.
+  uint64 accttime[3];         // time CSR cycles spent in each enum cpumode.
 };
 
 extern struct cpu cpus[NCPU];
@@ -91,18 +151,48 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // CPU whose run queue this process uses (last one it ran on)
+  int affinity;                // mask of CPUs it may run on; also under that CPU's rqlock
   int nice;                    // priority (nice value)
+  int group;                   // process group, whose run queue this process uses
+  int policy;                  // SCHED_NORMAL, SCHED_FIFO or SCHED_RR (sched.h)
+  int rtprio;                  // real-time priority, if not SCHED_NORMAL
 
   int weight;                  // weight value (derived from nice value)
   int is_eligible;             // eligibility flag
+  int slice;                   // requested base time slice (milliticks), see setslice()
   int timeslice;               // task's minimum time to run before preemption
   uint64 runtime;              // total runtime
   uint64 vruntime;             // virtual runtime (how long a process has run proportional to its weight)
   uint64 vdeadline;            // virtual deadline (earliest time by which a process should have received its due CPU time)
+  uint64 exec_start;           // r_time() when runtime was last updated while running
+  long vlag;                   // lag (average vruntime - vruntime) when it last went to sleep
+  uint64 sleep_start;          // r_time() when it last went to sleep
 
+  // the cpu's rqlock must be held when using these:
+  int on_rq;                   // If non-zero, queued on the run queue
+  int rb_red;                  // red-black tree node color
+  struct proc *rb_parent;      // run queue tree links
+  struct proc *rb_left;
+  struct proc *rb_right;
+  uint64 min_vruntime;         // smallest vruntime in this subtree
+  int on_rt;                   // If non-zero, queued on the real-time queue
+  struct proc *rt_next;        // real-time queue links
+  struct proc *rt_prev;
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // children that have not exited, newest first
+  struct proc *zombies;        // children that have exited, not yet waited for
+  struct proc *sibling_next;   // links in the parent's children or zombies list
+  struct proc *sibling_prev;
+
+  // pidhash_lock must be held when using this:
+  struct proc *pid_next;       // next in its pid hash chain
+
+  // proc_lock must be held when using these:
+  struct proc *allnext;        // next in allproc; set once, read without the lock
+  struct proc *freenext;       // next on the free list, if UNUSED
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -0,0 +1,15 @@
+// Process records, as returned by procsnap().
+
+struct procinfo {
+  int pid;
+  int weight;
+  uint64 runtime;   // milliticks run, including the current run
+  uint64 vruntime;
+  uint64 vdeadline;
+  uint64 sz;        // bytes of user memory
+  char state;       // enum procstate: UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE
+  char nice;
+  char cpu;         // CPU it runs on, or last ran on
+  char eligible;
+  char name[16];
+};
@@ -0,0 +1,149 @@
+// Real-time run queue.
+//
+// RUNNABLE SCHED_FIFO and SCHED_RR processes wait in one FIFO
+// list per priority (higher rtprio runs first); a one-word bitmap
+// of the non-empty lists (NRTPRIO is at most 32) makes the pick
+// a five-step binary search for its highest set bit, see rt_top().
+// Every CPU has its own (struct cpu's rt), checked before its
+// EEVDF queues.
+//
+// So that a runaway real-time process cannot starve the fair
+// class, a CPU may spend at most RTRUNTIME milliticks of every
+// RTPERIOD on real-time processes while fair ones wait.
+//
+// The caller must hold the CPU's rqlock.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+// Insert p at the tail of its priority's list, or at the head
+// if it was preempted and should keep its place.
+void
+rt_enqueue(struct rtqueue *rt, struct proc *p, int head)
+{
+  int prio = p->rtprio;
+
+  if(p->on_rt)
+    panic("rt_enqueue");
+
+  if(rt->head[prio] == 0){
+    p->rt_prev = p->rt_next = 0;
+    rt->head[prio] = rt->tail[prio] = p;
+    rt->bitmap |= 1U << prio;
+  } else if(head){
+    p->rt_prev = 0;
+    p->rt_next = rt->head[prio];
+    rt->head[prio]->rt_prev = p;
+    rt->head[prio] = p;
+  } else {
+    p->rt_next = 0;
+    p->rt_prev = rt->tail[prio];
+    rt->tail[prio]->rt_next = p;
+    rt->tail[prio] = p;
+  }
+  p->on_rt = 1;
+  rt->nr_running++;
+}
+
+// Remove p from the queue.
+void
+rt_dequeue(struct rtqueue *rt, struct proc *p)
+{
+  int prio = p->rtprio;
+
+  if(!p->on_rt)
+    panic("rt_dequeue");
+
+  if(p->rt_prev)
+    p->rt_prev->rt_next = p->rt_next;
+  else
+    rt->head[prio] = p->rt_next;
+  if(p->rt_next)
+    p->rt_next->rt_prev = p->rt_prev;
+  else
+    rt->tail[prio] = p->rt_prev;
+  if(rt->head[prio] == 0)
+    rt->bitmap &= ~(1U << prio);
+
+  p->rt_prev = p->rt_next = 0;
+  p->on_rt = 0;
+  rt->nr_running--;
+}
+
+// The highest priority among queued processes, or -1.
+// The kernel has no libgcc for __builtin_clz, so halve the
+// bitmap instead: a find-last-set in five steps.
+int
+rt_top(struct rtqueue *rt)
+{
+  uint x = rt->bitmap;
+  int n = 0;
+
+  if(x == 0)
+    return -1;
+  if(x & 0xffff0000){ n += 16; x >>= 16; }
+  if(x & 0xff00){ n += 8; x >>= 8; }
+  if(x & 0xf0){ n += 4; x >>= 4; }
+  if(x & 0xc){ n += 2; x >>= 2; }
+  if(x & 0x2){ n += 1; }
+  return n;
+}
+
+// The first queued process of the highest priority, or 0.
+// Does not dequeue it.
+struct proc*
+rt_pick(struct rtqueue *rt)
+{
+  int prio = rt_top(rt);
+
+  return prio < 0 ? 0 : rt->head[prio];
+}
+
+// The queued process after p in pick order, or 0.
+struct proc*
+rt_next(struct rtqueue *rt, struct proc *p)
+{
+  int prio;
+
+  if(p->rt_next)
+    return p->rt_next;
+  for(prio = p->rtprio - 1; prio >= 0; prio--)
+    if(rt->bitmap & (1U << prio))
+      return rt->head[prio];
+  return 0;
+}
+
+// start a new throttling period if the current one is over.
+static void
+rt_period(struct rtqueue *rt)
+{
+  uint64 now = r_time();
+
+  if(now - rt->period_start >= (uint64)RTPERIOD * TICKINTERVAL / 1000){
+    rt->period_start = now;
+    rt->runtime = 0;
+  }
+}
+
+// Charge the CPU's real-time budget for delta milliticks
+// of real-time run.
+void
+rt_charge(struct rtqueue *rt, uint64 delta)
+{
+  rt_period(rt);
+  rt->runtime += delta;
+}
+
+// Has the CPU used up its real-time budget for this period?
+// While it has, fair processes run before real-time ones.
+int
+rt_throttled(struct rtqueue *rt)
+{
+  rt_period(rt);
+  return rt->runtime >= RTRUNTIME;
+}
@@ -0,0 +1,4 @@
+// Scheduling policies, for setscheduler().
+#define SCHED_NORMAL  0   // EEVDF fair class, weighted by nice
+#define SCHED_FIFO    1   // real-time: runs until it sleeps or is preempted
+#define SCHED_RR      2   // real-time: as FIFO, but round-robin per slice
@@ -30,7 +30,7 @@ start()
   // delegate all interrupts and exceptions to supervisor mode.
   w_medeleg(0xffff);
   w_mideleg(0xffff);
-  w_sie(r_sie() | SIE_SEIE | SIE_STIE);
+  w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
   // configure Physical Memory Protection to give supervisor mode
   // access to all of physical memory.
@@ -60,6 +60,10 @@ timerinit()
   
   // allow supervisor to use stimecmp and time.
   w_mcounteren(r_mcounteren() | 2);
+
+  // allow user programs to read time too (rdtime), e.g.
+  // for schedbench's measurements.
+  w_scounteren(r_scounteren() | 2);
   
   // ask for the very first timer interrupt.
   w_stimecmp(r_time() + 1000000);
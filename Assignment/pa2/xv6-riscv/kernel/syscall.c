@@ -107,6 +107,19 @@ extern uint64 sys_setnice(void);
 extern uint64 sys_ps(void);
 extern uint64 sys_meminfo(void);
 extern uint64 sys_waitpid(void);
+extern uint64 sys_getslice(void);
+extern uint64 sys_setslice(void);
+extern uint64 sys_schedtrace(void);
+extern uint64 sys_getgroup(void);
+extern uint64 sys_setgroup(void);
+extern uint64 sys_setgroupnice(void);
+extern uint64 sys_getaffinity(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_getscheduler(void);
+extern uint64 sys_setscheduler(void);
+extern uint64 sys_procsnap(void);
+extern uint64 sys_cpustat(void);
+extern uint64 sys_memstat(void);
 
 
 // An array mapping syscall numbers from syscall.h
@@ -139,6 +152,19 @@ static uint64 (*syscalls[])(void) = {
 [SYS_ps] sys_ps,
 [SYS_meminfo] sys_meminfo,
 [SYS_waitpid] sys_waitpid,
+[SYS_getslice] sys_getslice,
+[SYS_setslice] sys_setslice,
+[SYS_schedtrace] sys_schedtrace,
+[SYS_getgroup] sys_getgroup,
+[SYS_setgroup] sys_setgroup,
+[SYS_setgroupnice] sys_setgroupnice,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getscheduler] sys_getscheduler,
+[SYS_setscheduler] sys_setscheduler,
+[SYS_procsnap] sys_procsnap,
+[SYS_cpustat] sys_cpustat,
+[SYS_memstat] sys_memstat,
 };
 
 void
@@ -26,3 +26,16 @@
 #define SYS_ps     25
 #define SYS_meminfo 26
 #define SYS_waitpid 27
+#define SYS_getslice 28
+#define SYS_setslice 29
+#define SYS_schedtrace 30
+#define SYS_getgroup 31
+#define SYS_setgroup 32
+#define SYS_setgroupnice 33
+#define SYS_getaffinity 34
+#define SYS_setaffinity 35
+#define SYS_getscheduler 36
+#define SYS_setscheduler 37
+#define SYS_procsnap 38
+#define SYS_cpustat 39
+#define SYS_memstat 40
@@ -6,6 +6,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "vm.h"
+#include "memstat.h"
 
 uint64
 sys_exit(void)
@@ -72,12 +73,17 @@ sys_pause(void)
   if(n < 0)
     n = 0;
   acquire(&tickslock);
+  tickupdate();
   ticks0 = ticks;
   while(ticks - ticks0 < n){
     if(killed(myproc())){
       release(&tickslock);
       return -1;
     }
+    // there is no periodic tick; ask for a timer
+    // interrupt when this sleep is due.
+    if(tickexpiry == 0 || ticks0 + n < tickexpiry)
+      tickexpiry = ticks0 + n;
     sleep(&ticks, &tickslock);
   }
   release(&tickslock);
@@ -101,6 +107,7 @@ sys_uptime(void)
   uint xticks;
 
   acquire(&tickslock);
+  tickupdate();
   xticks = ticks;
   release(&tickslock);
   return xticks;
@@ -170,3 +177,180 @@ sys_waitpid(void)
 
     return waitpid(pid);
 }
+
+// return requested time slice of pid (milliticks)
+// -1 if error
+uint64
+sys_getslice(void)
+{
+    int pid;
+    //get argument
+    argint(0, &pid);
+
+    return getslice(pid);
+}
+
+//request time slice (milliticks) for pid
+// 0 for success, -1 on error
+uint64
+sys_setslice(void)
+{
+    int pid, value;
+    //get arguments
+    argint(0, &pid);
+    argint(1, &value);
+
+    return setslice(pid, value);
+}
+
+// drain up to n scheduler trace events into buf
+// returns number of events copied, -1 if error
+uint64
+sys_schedtrace(void)
+{
+    uint64 buf;
+    int n;
+    //get arguments
+    argaddr(0, &buf);
+    argint(1, &n);
+
+    if(n < 0)
+        return -1;
+    return schedtrace(buf, n);
+}
+
+// return process group of pid
+// -1 if error
+uint64
+sys_getgroup(void)
+{
+    int pid;
+    //get argument
+    argint(0, &pid);
+
+    return getgroup(pid);
+}
+
+//move pid into a process group
+// 0 for success, -1 on error
+uint64
+sys_setgroup(void)
+{
+    int pid, group;
+    //get arguments
+    argint(0, &pid);
+    argint(1, &group);
+
+    return setgroup(pid, group);
+}
+
+//set nice value (weight) of a process group
+// 0 for success, -1 on error
+uint64
+sys_setgroupnice(void)
+{
+    int group, value;
+    //get arguments
+    argint(0, &group);
+    argint(1, &value);
+
+    return setgroupnice(group, value);
+}
+
+// return CPU affinity mask of pid
+// -1 if error
+uint64
+sys_getaffinity(void)
+{
+    int pid;
+    //get argument
+    argint(0, &pid);
+
+    return getaffinity(pid);
+}
+
+//restrict pid to the CPUs in a mask
+// 0 for success, -1 on error
+uint64
+sys_setaffinity(void)
+{
+    int pid, mask;
+    //get arguments
+    argint(0, &pid);
+    argint(1, &mask);
+
+    return setaffinity(pid, mask);
+}
+
+// return scheduling policy of pid, and its real-time
+// priority into *prio if prio isn't null
+// -1 if error
+uint64
+sys_getscheduler(void)
+{
+    int pid;
+    uint64 prio;
+    //get arguments
+    argint(0, &pid);
+    argaddr(1, &prio);
+
+    return getscheduler(pid, prio);
+}
+
+//set scheduling policy and real-time priority of pid
+// 0 for success, -1 on error
+uint64
+sys_setscheduler(void)
+{
+    int pid, policy, prio;
+    //get arguments
+    argint(0, &pid);
+    argint(1, &policy);
+    argint(2, &prio);
+
+    return setscheduler(pid, policy, prio);
+}
+
+// copy up to n process records (procinfo.h) into buf
+// returns number of records copied, -1 if error
+uint64
+sys_procsnap(void)
+{
+    uint64 buf;
+    int n;
+    //get arguments
+    argaddr(0, &buf);
+    argint(1, &n);
+
+    if(n < 0)
+        return -1;
+    return procsnap(buf, n);
+}
+
+// copy per-CPU times and load averages (cpustat.h) into buf
+// returns 0, or -1 if error
+uint64
+sys_cpustat(void)
+{
+    uint64 buf;
+    //get arguments
+    argaddr(0, &buf);
+
+    return cpustat(buf);
+}
+
+//copy page counts by kind (memstat.h) into buf
+//returns 0, or -1 if error
+uint64
+sys_memstat(void)
+{
+    uint64 buf;
+    struct memstat st;
+    //get arguments
+    argaddr(0, &buf);
+
+    memstat_read(&st);
+    if(copyout(myproc()->pagetable, buf, (char*)&st, sizeof(st)) < 0)
+        return -1;
+    return 0;
+}
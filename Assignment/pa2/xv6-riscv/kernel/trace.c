@@ -0,0 +1,129 @@
+//
+// Scheduler event trace.
+//
+// Each CPU logs scheduler events into a ring buffer of its own.
+// Only that CPU writes the ring, with interrupts off, so logging
+// takes no locks: the writer fills a slot and then publishes it
+// by advancing head. schedtrace() copies slots out and then
+// re-reads head, throwing away any slot the writer may have
+// overwritten in the meantime. A full ring overwrites its oldest
+// events.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+#include "defs.h"
+
+#define NTRACE 512  // events per CPU
+
+struct tracering {
+  uint64 head;                  // events ever logged; written by its CPU only
+  uint64 tail;                  // events already read; tracelock must be held
+  struct schedevent ev[NTRACE];
+};
+
+static struct tracering rings[NCPU];
+
+// serializes readers; writers never take it.
+static struct spinlock tracelock;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// log a scheduler event of the given type for p
+// into this CPU's ring. p->lock must be held.
+void
+tracesched(int type, struct proc *p)
+{
+  struct tracering *r;
+  struct schedevent *e;
+  uint64 h;
+
+  push_off();
+  r = &rings[cpuid()];
+  h = r->head;
+
+  // the previous event must be published before a reader can
+  // see this slot being overwritten.
+  __sync_synchronize();
+
+  e = &r->ev[h % NTRACE];
+  e->time = r_time();
+  e->vruntime = p->vruntime;
+  e->vdeadline = p->vdeadline;
+  e->pid = p->pid;
+  e->type = type;
+  e->cpu = cpuid();
+  e->nice = p->nice;
+  e->eligible = p->is_eligible;
+  e->runnable = p->state == RUNNABLE;
+
+  __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+// copy up to n logged events to user address addr and forget
+// them. events come CPU by CPU, each CPU's oldest first.
+// returns the number of events copied, or -1.
+int
+schedtrace(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct schedevent batch[16];
+  uint64 heads[NCPU];
+  uint64 start, h;
+  int i, j, k, copied = 0;
+
+  acquire(&tracelock);
+
+  // note where every ring ends first, so that an event on one CPU
+  // isn't returned without an earlier one it depends on elsewhere.
+  for(i = 0; i < NCPU; i++)
+    heads[i] = __atomic_load_n(&rings[i].head, __ATOMIC_ACQUIRE);
+
+  for(i = 0; i < NCPU && copied < n; i++){
+    struct tracering *r = &rings[i];
+
+    // skip what the ring has already overwritten
+    start = r->tail;
+    if(heads[i] > NTRACE && start < heads[i] - NTRACE)
+      start = heads[i] - NTRACE;
+    while(start < heads[i] && copied < n){
+      k = heads[i] - start;
+      if(k > NELEM(batch))
+        k = NELEM(batch);
+      if(k > n - copied)
+        k = n - copied;
+      for(j = 0; j < k; j++)
+        batch[j] = r->ev[(start + j) % NTRACE];
+
+      // an event was overwritten if its slot has been reused,
+      // i.e. head has moved NTRACE past it.
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+      j = 0;
+      while(j < k && start + j + NTRACE <= h)
+        j++;
+
+      if(copyout(p->pagetable, addr + copied * sizeof(struct schedevent),
+                 (char*)&batch[j], (k - j) * sizeof(struct schedevent)) < 0){
+        release(&tracelock);
+        return -1;
+      }
+      copied += k - j;
+      start += k;
+    }
+    r->tail = start;
+  }
+
+  release(&tracelock);
+  return copied;
+}
@@ -0,0 +1,19 @@
+// Scheduler trace events, as returned by schedtrace().
+
+#define TRACE_SWITCHIN  1   // CPU starts running the process
+#define TRACE_SWITCHOUT 2   // CPU stops running the process
+#define TRACE_WAKEUP    3   // sleeping process made runnable
+#define TRACE_FORK      4   // new process made runnable
+#define TRACE_EXIT      5   // process exits
+
+struct schedevent {
+  uint64 time;      // time CSR when the event was logged
+  uint64 vruntime;
+  uint64 vdeadline;
+  int pid;
+  char type;        // TRACE_*
+  char cpu;         // CPU that logged the event
+  char nice;
+  char eligible;
+  char runnable;    // TRACE_SWITCHOUT: still runnable (preempted or yielded)
+};
@@ -4,10 +4,12 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
 struct spinlock tickslock;
 uint ticks;
+uint tickexpiry;  // earliest tick a pause() sleeper waits for, or 0 if none
 
 extern char trampoline[], uservec[];
 
@@ -29,6 +31,83 @@ trapinithart(void)
   w_stvec((uint64)kernelvec);
 }
 
+// charge the running real-time process p for the time it has
+// run, and yield once a round-robin slice runs out, once its
+// CPU's real-time budget is used up (scheduler() then prefers
+// fair processes, if any wait), or when another hart asks.
+// p->lock must be held; releases it.
+static void
+rt_tick(struct proc *p)
+{
+    struct cpu *c = &cpus[p->cpu];
+    int throttled;
+
+    acquire(&c->rqlock);
+    rt_charge(&c->rt, update_runtime(p));
+    throttled = rt_throttled(&c->rt);
+    release(&c->rqlock);
+
+    // scheduler() refills the slice and moves it to the back
+    int expired = p->policy == SCHED_RR && p->timeslice <= 0;
+    release(&p->lock);
+    if(expired || throttled || mycpu()->need_resched)
+        yield();
+}
+
+// EEVDF Scheduler logic
+// charge the running process p for the time it has run,
+// and yield once it has used up its time slice or another
+// hart has woken a process that should preempt it.
+static void
+eevdf_tick(struct proc *p)
+{
+    struct cpu *c;
+
+    // update runtime/vruntime/time slice for each timer interrupt
+    // for currently running process
+    if(p == 0 || p->state != RUNNING)
+        return;
+
+    acquire(&p->lock);
+    if(p->policy != SCHED_NORMAL)
+    {
+        rt_tick(p);
+        return;
+    }
+    c = &cpus[p->cpu];
+
+    // update runtime, timeslice and vruntime, and those of its
+    // group, by the time actually spent running since the last
+    // update. real-time processes queued here run first, once
+    // the CPU's real-time budget is renewed.
+    acquire(&c->rqlock);
+    rq_update_curr(&c->rq[p->group], p);
+    int rtwait = c->rt.nr_running && !rt_throttled(&c->rt);
+    release(&c->rqlock);
+
+    // if task runs more than given time slice
+    // update vdeadline and enforce a yield
+    if(p->timeslice <= 0)
+    {
+        // reset timeslice to the requested slice, and
+        // move vdeadline on by one slice of virtual time
+        new_slice(p);
+        release(&p->lock);
+        // enforce yield
+        yield();
+    }
+    else if(mycpu()->need_resched || rtwait)
+    {
+        // keep the remaining timeslice and vdeadline
+        release(&p->lock);
+        yield();
+    }
+    else
+    {
+        release(&p->lock);
+    }
+}
+
 //
 // handle an interrupt, exception, or system call from user space.
 // called from, and returns to, trampoline.S
@@ -46,6 +125,8 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);  //DOC: kernelvec
 
+  cpuacct(CPU_KERNEL);
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -80,50 +161,10 @@ usertrap(void)
   if(killed(p))
     kexit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
-  {
-    // EEVDF Scheduler logic
-    
-    // update runtime/vruntime/time slice for each timer interrupt
-    // for currently running process
-    if(p != 0 && p->state == RUNNING)
-    { 
-        acquire(&p->lock);
-        
-        // increment runtime (in terms of millitick unit)
-        p->runtime += 1000;
-        
-        // decrement timeslice (in terms of millitick unit)
-        p->timeslice -= 1000;
-
-        // update vruntime using formula
-        // vruntime += runtime * 1024 / weight
-        // 1 runtime = 1000 milliticks
-        p->vruntime += ((uint64)1000 * (uint64)1024) / p->weight;
-    
-        // if task runs more than given time slice
-        // update vdeadline and enforce a yield
-        if(p->timeslice <= 0)
-        {
-            // reset timeslice to base value
-            // 5000 milliticks
-            p->timeslice = 5000;
-
-            // update vdeadline
-            // vdeadline = vruntime + base time slice (5000 milliticks) * 1024 / weight
-            p->vdeadline = p->vruntime + ((uint64)5000 * (uint64)1024) / p->weight;
-            release(&p->lock);
-            // enforce yield
-            yield();
-        }
-        else
-        {
-            release(&p->lock);
-        }
-    }
-
-  }
+  // give up the CPU if this is a timer interrupt and the
+  // time slice has run out, or a reschedule request.
+  if(which_dev == 2 || which_dev == 3)
+    eevdf_tick(p);
 
   prepare_return();
 
@@ -147,6 +188,8 @@ prepare_return(void)
   // code to usertrap would be a disaster, turn off interrupts.
   intr_off();
 
+  cpuacct(CPU_USER);
+
   // send syscalls, interrupts, and exceptions to uservec in trampoline.S
   uint64 trampoline_uservec = TRAMPOLINE + (uservec - trampoline);
   w_stvec(trampoline_uservec);
@@ -192,9 +235,10 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0)
-    yield();
+  // give up the CPU if this is a timer interrupt and the
+  // time slice has run out, or a reschedule request.
+  if(which_dev == 2 || which_dev == 3)
+    eevdf_tick(myproc());
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -205,22 +249,82 @@ kerneltrap()
 void
 clockintr()
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
+  acquire(&tickslock);
+  tickupdate();
+  // wake pause() sleepers once the earliest of them is due;
+  // those that need to sleep longer ask again.
+  if(tickexpiry != 0 && ticks >= tickexpiry){
+    tickexpiry = 0;
     wakeup(&ticks);
-    release(&tickslock);
   }
+  release(&tickslock);
+
+  loadupdate();
 
   // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 100000);
+  // the interrupt request.
+  settimer();
+}
+
+// bring ticks up to date with the time CSR. timer interrupts
+// no longer arrive once per tick, so ticks is derived from the
+// time rather than counted.
+// caller must hold tickslock.
+void
+tickupdate(void)
+{
+  ticks = r_time() / TICKINTERVAL;
+}
+
+// program this hart's next timer interrupt. there is no periodic
+// tick: interrupt when the running process's time slice ends or
+// when the earliest pause() sleeper is due, whichever is first.
+// an idle hart with no sleeper to wake is not interrupted at all.
+// interrupts must be disabled.
+void
+settimer(void)
+{
+  struct proc *p = mycpu()->proc;
+  uint64 now = r_time();
+  uint64 when = -1;
+  uint expiry = tickexpiry;  // a stale read only costs an extra interrupt
+
+  struct rtqueue *rt = &mycpu()->rt;
+
+  if(p != 0 && p->state == RUNNING){
+    // timeslice is in milliticks, counted from exec_start.
+    // a FIFO process has none.
+    if(p->timeslice > 0 && p->policy != SCHED_FIFO)
+      when = p->exec_start + (uint64)p->timeslice * TICKINTERVAL / 1000;
+    // a real-time process also stops when the CPU's real-time
+    // budget runs out.
+    if(p->policy != SCHED_NORMAL && rt->runtime < RTRUNTIME &&
+       p->exec_start + (RTRUNTIME - rt->runtime) * TICKINTERVAL / 1000 < when)
+      when = p->exec_start + (RTRUNTIME - rt->runtime) * TICKINTERVAL / 1000;
+    // the slice has already run out and the tick handler is
+    // about to yield; check back in a tick in case it doesn't.
+    if(when <= now)
+      when = now + TICKINTERVAL;
+  }
+  // real-time processes throttled behind fair ones run again
+  // when the budget is renewed.
+  if(rt->nr_running && rt->runtime >= RTRUNTIME &&
+     rt->period_start + (uint64)RTPERIOD * TICKINTERVAL / 1000 < when)
+    when = rt->period_start + (uint64)RTPERIOD * TICKINTERVAL / 1000;
+  // an idle hart that left cache-hot work queued on other
+  // harts looks again once that work has cooled down.
+  if(p == 0 && mycpu()->balance_at != 0 && mycpu()->balance_at < when)
+    when = mycpu()->balance_at;
+  if(expiry != 0 && (uint64)expiry * TICKINTERVAL < when)
+    when = (uint64)expiry * TICKINTERVAL;
+
+  w_stimecmp(when);
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
+// returns 3 if reschedule request from another hart,
+// 2 if timer interrupt,
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -253,8 +357,24 @@ devintr()
     // timer interrupt.
     clockintr();
     return 2;
+  } else if(scause == 0x8000000000000001L){
+    // supervisor software interrupt: another hart (or this
+    // one) wants this hart to reschedule, see sendipi(). the
+    // running process's slice may have changed too (setslice()),
+    // so program the timer again.
+    w_sip(r_sip() & ~SIP_SSIP);
+    settimer();
+    return 3;
   } else {
     return 0;
   }
 }
 
+
+// raise a supervisor software interrupt on hart,
+// via the ACLINT SSWI device.
+void
+sendipi(int hart)
+{
+  *(volatile uint32 *)SSWI_SETSSIP(hart) = 1;
+}
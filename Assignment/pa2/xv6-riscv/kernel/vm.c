@@ -7,6 +7,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "fs.h"
+#include "memstat.h"
 
 /*
  * the kernel's page table.
@@ -25,6 +26,7 @@ kvmmake(void)
 
   kpgtbl = (pagetable_t) kalloc();
   memset(kpgtbl, 0, PGSIZE);
+  memcount(MEM_PGTBL, 1);
 
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
@@ -35,6 +37,9 @@ kvmmake(void)
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
+  // ACLINT SSWI, for inter-processor interrupts
+  kvmmap(kpgtbl, SSWI, SSWI, PGSIZE, PTE_R | PTE_W);
+
   // map kernel text executable and read-only.
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
@@ -45,8 +50,8 @@ kvmmake(void)
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // allocate and map a kernel stack for each process.
-  proc_mapstacks(kpgtbl);
+  // kernel stacks are mapped as processes are created;
+  // see kvmmapstack().
   
   return kpgtbl;
 }
@@ -61,6 +66,25 @@ kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
     panic("kvmmap");
 }
 
+// Allocate a kernel stack page and map it at va in the kernel
+// page table, for a newly created struct proc (see procgrow()).
+// The caller serializes these, and makes the other CPUs flush
+// their TLBs before they use the stack.
+// Returns 0, or -1 if out of memory.
+int
+kvmmapstack(uint64 va)
+{
+  char *pa;
+
+  if((pa = kalloc()) == 0)
+    return -1;
+  if(mappages(kernel_pagetable, va, PGSIZE, (uint64)pa, PTE_R | PTE_W) != 0){
+    kfree(pa);
+    return -1;
+  }
+  return 0;
+}
+
 // Initialize the kernel_pagetable, shared by all CPUs.
 void
 kvminit(void)
@@ -108,6 +132,7 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
       memset(pagetable, 0, PGSIZE);
+      memcount(MEM_PGTBL, 1);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -183,6 +208,7 @@ uvmcreate()
   if(pagetable == 0)
     return 0;
   memset(pagetable, 0, PGSIZE);
+  memcount(MEM_PGTBL, 1);
   return pagetable;
 }
 
@@ -206,6 +232,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     if(do_free){
       uint64 pa = PTE2PA(*pte);
       kfree((void*)pa);
+      memcount(MEM_USER, -1);
     }
     *pte = 0;
   }
@@ -235,6 +262,7 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
+    memcount(MEM_USER, 1);
   }
   return newsz;
 }
@@ -275,6 +303,7 @@ freewalk(pagetable_t pagetable)
     }
   }
   kfree((void*)pagetable);
+  memcount(MEM_PGTBL, -1);
 }
 
 // Free user memory pages,
@@ -315,6 +344,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
       kfree(mem);
       goto err;
     }
+    memcount(MEM_USER, 1);
   }
   return 0;
 
@@ -469,6 +499,7 @@ vmfault(pagetable_t pagetable, uint64 va, int read)
     kfree((void *)mem);
     return 0;
   }
+  memcount(MEM_USER, 1);
   return mem;
 }
 
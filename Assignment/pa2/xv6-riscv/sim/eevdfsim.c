@@ -0,0 +1,591 @@
+// Host-side simulator for the EEVDF scheduler.
+//
+// usage: eevdfsim [-n tasks] [-g groups] [-t ticks] [-s seed]
+//                 [-w percent] [-e permille] [-f tracefile] [-v]
+//
+// Links kernel/eevdf.c unchanged and drives one simulated CPU
+// with it, the way scheduler(), make_runnable() and eevdf_tick()
+// do: pick, run until the slice ends, the task sleeps or a
+// wakeup preempts it, requeue. Time is in milliticks and jumps
+// from event to event, so thousands of tasks and long runs take
+// seconds.
+//
+// Each task is compared against the ideal (GPS) schedule, which
+// serves every runnable task at once in proportion to its
+// weight, within its group's share. Results are key=value lines,
+// like schedbench's:
+//   share error: |received - ideal| / ideal over the run
+//   max lag:     largest |ideal - received| seen, in milliticks
+//   pick cost:   host nanoseconds per rq_pick_next()
+// Only tasks given at least a hundred slices by the ideal are
+// measured. A sleeper's lag is clamped and decays while it
+// sleeps (clamp_lag(), decay_lag()), so tasks that sleep often
+// drift from the ideal by design, and the hogs they share the
+// CPU with drift the other way; the two are reported on
+// separate lines. The run fails (exit status 1) if a hog's
+// share error exceeds -e permille (default 20); in the default
+// all-hog scenario that is what a broken weight, deadline or
+// pick looks like.
+//
+// Without -f, -n tasks (default 50) are made up from the seed:
+// random nice values, CPU hogs but for -w percent of them
+// (default 0) that alternate random run and sleep bursts. A trace file has one task per line:
+//   nice [group] [run sleep run sleep ...]
+// bursts in milliticks, repeated once used up; a task without
+// bursts is a hog. '#' starts a comment.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/spinlock.h"
+#include "kernel/proc.h"
+
+// from kernel/defs.h, which clashes with the host's libc.
+// eevdf.c calls the last three; they are defined below.
+void            rq_enqueue(struct runqueue*, struct proc*);
+void            rq_attach(struct runqueue*, struct proc*);
+void            rq_detach(struct runqueue*, struct proc*);
+void            rq_update_curr(struct runqueue*, struct proc*);
+struct proc*    rq_pick_next(struct cpu*);
+int             rq_wake(struct runqueue*, struct proc*);
+void            rq_sleep(struct runqueue*, struct proc*);
+void            charge(struct proc*, uint64);
+void            new_slice(struct proc*);
+long            decay_lag(long, uint64);
+void            panic(char*) __attribute__((noreturn));
+int             rt_throttled(struct rtqueue*);
+uint64          update_runtime(struct proc*);
+
+#define MAXBURST 64
+
+struct task {
+  struct proc *p;
+  int nburst;                 // run/sleep bursts, 0 for a hog
+  uint64 burst[MAXBURST];
+  int next;                   // next burst to use
+  uint64 left;                // milliticks left of the current run burst
+  uint64 wake;                // when it wakes, while sleeping
+  int heap;                   // position in the sleep heap, or -1
+
+  double vstart;              // group's ideal virtual time when it became runnable
+  double ideal;               // ideal service before vstart (milliticks)
+  double maxlag;
+};
+
+// ideal schedule of a group: its runnable tasks share its
+// service in proportion to their weights.
+struct ideal {
+  double v;                   // service per unit of task weight so far
+  double weight;              // weight of its runnable tasks
+};
+
+struct cpu cpus[NCPU];
+struct group groups[NGROUP];
+
+struct task *tasks;
+int ntask;
+int ngroup = 1;
+struct ideal ideal[NGROUP];
+struct task **sleepers;       // min-heap on wake
+int nsleep;
+
+uint64 now;                   // milliticks
+uint64 npick;
+double picksum, pickmax;
+int verbose;
+double maxerr = 20;           // permille, for hogs
+
+// called by eevdf.c
+void
+panic(char *s)
+{
+  fprintf(stderr, "eevdfsim: panic: %s\n", s);
+  exit(1);
+}
+
+// there are no real-time tasks in the simulation
+int
+rt_throttled(struct rtqueue *rt)
+{
+  return 0;
+}
+
+// as in proc.c, with the simulated clock
+uint64
+update_runtime(struct proc *p)
+{
+  uint64 delta = now - p->exec_start;
+
+  p->exec_start = now;
+  charge(p, delta);
+  return delta;
+}
+
+static uint64
+rnd(uint64 n)
+{
+  return ((uint64)random() << 31 ^ random()) % n;
+}
+
+static double
+ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct task*
+task(struct proc *p)
+{
+  return &tasks[p->pid - 1];
+}
+
+// sleep heap, ordered by wake time
+
+static void
+heapswap(int i, int j)
+{
+  struct task *t = sleepers[i];
+
+  sleepers[i] = sleepers[j];
+  sleepers[j] = t;
+  sleepers[i]->heap = i;
+  sleepers[j]->heap = j;
+}
+
+static void
+heappush(struct task *t)
+{
+  int i = nsleep++;
+
+  sleepers[i] = t;
+  t->heap = i;
+  while(i > 0 && sleepers[(i-1)/2]->wake > sleepers[i]->wake){
+    heapswap(i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static struct task*
+heappop(void)
+{
+  struct task *t = sleepers[0];
+  int i = 0, c;
+
+  heapswap(0, --nsleep);
+  for(;;){
+    c = 2*i + 1;
+    if(c >= nsleep)
+      break;
+    if(c+1 < nsleep && sleepers[c+1]->wake < sleepers[c]->wake)
+      c++;
+    if(sleepers[i]->wake <= sleepers[c]->wake)
+      break;
+    heapswap(i, c);
+    i = c;
+  }
+  t->heap = -1;
+  return t;
+}
+
+// ideal schedule
+
+// serve the runnable tasks for dt milliticks: the active groups
+// share it by weight, and each group's tasks share its part.
+static void
+ideal_advance(uint64 dt)
+{
+  double gw = 0;
+  int g;
+
+  for(g = 0; g < ngroup; g++)
+    if(ideal[g].weight > 0)
+      gw += groups[g].weight;
+  if(gw == 0)
+    return;
+  for(g = 0; g < ngroup; g++)
+    if(ideal[g].weight > 0)
+      ideal[g].v += dt * groups[g].weight / gw / ideal[g].weight;
+}
+
+static double
+ideal_service(struct task *t)
+{
+  double s = t->ideal;
+
+  if(t->p->state == RUNNABLE || t->p->state == RUNNING)
+    s += t->p->weight * (ideal[t->p->group].v - t->vstart);
+  return s;
+}
+
+static void
+ideal_start(struct task *t)
+{
+  ideal[t->p->group].weight += t->p->weight;
+  t->vstart = ideal[t->p->group].v;
+}
+
+static void
+ideal_stop(struct task *t)
+{
+  t->ideal += t->p->weight * (ideal[t->p->group].v - t->vstart);
+  ideal[t->p->group].weight -= t->p->weight;
+}
+
+static void
+sample(void)
+{
+  double lag;
+  int i;
+
+  for(i = 0; i < ntask; i++){
+    lag = ideal_service(&tasks[i]) - tasks[i].p->runtime;
+    if(lag < 0)
+      lag = -lag;
+    if(lag > tasks[i].maxlag)
+      tasks[i].maxlag = lag;
+  }
+}
+
+// setup
+
+static struct task*
+newtask(int nice, int group)
+{
+  struct task *t;
+  struct proc *p;
+
+  tasks = realloc(tasks, (ntask + 1) * sizeof(*tasks));
+  if(tasks == 0)
+    panic("out of memory");
+  t = &tasks[ntask];
+  memset(t, 0, sizeof(*t));
+  p = calloc(1, sizeof(*p));
+  if(p == 0)
+    panic("out of memory");
+  t->p = p;
+  t->heap = -1;
+  p->pid = ++ntask;
+  p->nice = nice;
+  p->weight = weight_table[nice];
+  p->group = group;
+  p->slice = BASESLICE;
+  p->timeslice = BASESLICE;
+  p->state = SLEEPING;
+  return t;
+}
+
+static void
+synthesize(int n, int pct)
+{
+  struct task *t;
+  int i, j;
+
+  for(i = 0; i < n; i++){
+    t = newtask(rnd(40), i % ngroup);
+    if(i * pct / 100 == (i + 1) * pct / 100)
+      continue;
+    t->nburst = 2 * (1 + rnd(MAXBURST / 2));
+    for(j = 0; j < t->nburst; j += 2){
+      t->burst[j] = 1 + rnd(2 * BASESLICE);
+      t->burst[j+1] = 1 + rnd(20 * BASESLICE);
+    }
+  }
+}
+
+static void
+readtrace(char *path)
+{
+  char line[1024], *s, *end;
+  long v[MAXBURST + 2];
+  struct task *t;
+  FILE *f;
+  int n, i, lineno = 0;
+
+  if((f = fopen(path, "r")) == 0){
+    perror(path);
+    exit(1);
+  }
+  while(fgets(line, sizeof(line), f)){
+    lineno++;
+    if((s = strchr(line, '#')) != 0)
+      *s = 0;
+    n = 0;
+    for(s = line; n < MAXBURST + 2; s = end){
+      v[n] = strtol(s, &end, 10);
+      if(end == s)
+        break;
+      n++;
+    }
+    if(n == 0)
+      continue;
+    // an odd count after nice means the group was given
+    i = (n % 2 == 0) ? 2 : 1;
+    if(v[0] < 0 || v[0] >= 40 || (i == 2 && (v[1] < 0 || v[1] >= ngroup))){
+      fprintf(stderr, "eevdfsim: %s:%d: bad nice or group\n", path, lineno);
+      exit(1);
+    }
+    t = newtask(v[0], i == 2 ? v[1] : 0);
+    for(; i < n; i++){
+      if(v[i] <= 0){
+        fprintf(stderr, "eevdfsim: %s:%d: bursts must be positive\n", path, lineno);
+        exit(1);
+      }
+      t->burst[t->nburst++] = v[i];
+    }
+  }
+  fclose(f);
+}
+
+// simulation
+
+// as make_runnable(): the lag it left with decays over its sleep
+static int
+wake(struct task *t)
+{
+  struct proc *p = t->p;
+  struct runqueue *rq = &cpus[0].rq[p->group];
+
+  if(p->state == SLEEPING)
+    p->vlag = decay_lag(p->vlag, now - p->sleep_start);
+  p->state = RUNNABLE;
+  ideal_start(t);
+  if(t->nburst){
+    t->left = t->burst[t->next];
+    t->next = (t->next + 1) % t->nburst;
+  }
+  return rq_wake(rq, p);
+}
+
+// as the end of a scheduler() round: charge p, then requeue it
+// or let it sleep until its next burst.
+static void
+switchout(struct proc *p)
+{
+  struct runqueue *rq = &cpus[0].rq[p->group];
+  struct task *t = task(p);
+
+  rq_update_curr(rq, p);
+  if(p->state == SLEEPING){
+    rq_sleep(rq, p);
+    p->sleep_start = now;
+    ideal_stop(t);
+    t->wake = now + t->burst[t->next];
+    t->next = (t->next + 1) % t->nburst;
+    heappush(t);
+  } else {
+    rq_enqueue(rq, p);
+  }
+  rq_detach(rq, p);
+}
+
+static void
+run(uint64 end)
+{
+  struct cpu *c = &cpus[0];
+  struct proc *p = 0;
+  struct task *t;
+  uint64 stop, t0;
+  int preempt = 0, i;
+  double t1, cost;
+
+  for(i = 0; i < ntask; i++)
+    if(wake(&tasks[i]))
+      preempt = 1;
+  t0 = now;
+
+  while(now < end){
+    while(nsleep > 0 && sleepers[0]->wake <= now)
+      if(wake(heappop()) && p)
+        preempt = 1;
+
+    if(p && preempt){
+      // as eevdf_tick() on a resched: keep slice and deadline
+      p->state = RUNNABLE;
+      switchout(p);
+      p = 0;
+    }
+    preempt = 0;
+
+    if(p == 0){
+      t1 = ns();
+      p = rq_pick_next(c);
+      cost = ns() - t1;
+      if(p == 0){
+        // idle until the next wakeup
+        stop = nsleep > 0 && sleepers[0]->wake < end ? sleepers[0]->wake : end;
+        now = stop;
+        continue;
+      }
+      npick++;
+      picksum += cost;
+      if(cost > pickmax)
+        pickmax = cost;
+      rq_attach(&c->rq[p->group], p);
+      p->state = RUNNING;
+      p->exec_start = now;
+    }
+
+    // run until its slice or burst ends, or the next wakeup
+    t = task(p);
+    stop = now + (p->timeslice > 0 ? p->timeslice : 1);
+    if(t->nburst && now + t->left < stop)
+      stop = now + t->left;
+    if(nsleep > 0 && sleepers[0]->wake < stop)
+      stop = sleepers[0]->wake;
+    if(end < stop)
+      stop = end;
+    ideal_advance(stop - now);
+    if(t->nburst)
+      t->left -= stop - now;
+    now = stop;
+
+    rq_update_curr(&c->rq[p->group], p);
+    if(t->nburst && t->left == 0){
+      p->state = SLEEPING;
+      switchout(p);
+      p = 0;
+    } else if(p->timeslice <= 0){
+      // as eevdf_tick(): a new slice, and yield
+      new_slice(p);
+      p->state = RUNNABLE;
+      switchout(p);
+      p = 0;
+    }
+
+    // lag is bounded by about a slice; sampling every few
+    // slices of simulated time catches its extremes cheaply.
+    if(now - t0 >= 4 * BASESLICE){
+      sample();
+      t0 = now;
+    }
+  }
+  if(p)
+    rq_update_curr(&c->rq[p->group], p);
+  sample();
+}
+
+// share error of the tasks that stayed runnable (hog), or of
+// those that slept (!hog); returns the largest.
+static double
+share_err(int hog)
+{
+  struct task *t;
+  double ideal, err, errsum = 0, errmax = 0, lagmax = 0;
+  int i, n = 0;
+
+  for(i = 0; i < ntask; i++){
+    t = &tasks[i];
+    if((t->nburst == 0) != hog)
+      continue;
+    ideal = ideal_service(t);
+    if(t->maxlag > lagmax)
+      lagmax = t->maxlag;
+    // a task runs a slice at a time: below a hundred slices
+    // of service, rounding to slices alone exceeds 1%.
+    if(ideal < 100 * BASESLICE)
+      continue;
+    err = (t->p->runtime - ideal) / ideal;
+    if(err < 0)
+      err = -err;
+    errsum += err;
+    if(err > errmax)
+      errmax = err;
+    n++;
+    if(verbose)
+      printf("eevdfsim task=%d nice=%d group=%d hog=%d ideal_mt=%.0f got_mt=%lu err_permille=%.1f max_lag_mt=%.0f\n",
+             t->p->pid, t->p->nice, t->p->group, hog, ideal,
+             t->p->runtime, err * 1000, t->maxlag);
+  }
+
+  printf("eevdfsim %s measured=%d share_err_avg_permille=%.2f share_err_max_permille=%.2f max_lag_mt=%.0f\n",
+         hog ? "hogs" : "sleepers", n, n ? errsum / n * 1000 : 0,
+         errmax * 1000, lagmax);
+  return errmax * 1000;
+}
+
+static int
+report(uint64 ticks)
+{
+  double err;
+
+  printf("eevdfsim tasks=%d groups=%d ticks=%lu picks=%lu pick_ns_avg=%.0f pick_ns_max=%.0f\n",
+         ntask, ngroup, ticks, npick, npick ? picksum / npick : 0, pickmax);
+  share_err(0);
+  err = share_err(1);
+  if(err > maxerr){
+    printf("eevdfsim FAIL hog share error %.2f permille > %.2f\n", err, maxerr);
+    return 1;
+  }
+  return 0;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: eevdfsim [-n tasks] [-g groups] [-t ticks] [-s seed] [-w percent] [-e permille] [-f tracefile] [-v]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *trace = 0;
+  uint64 ticks = 100000;
+  int n = 50, pct = 0, g, i;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-v") == 0)
+      verbose = 1;
+    else if(i + 1 >= argc)
+      usage();
+    else if(strcmp(argv[i], "-n") == 0)
+      n = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-g") == 0)
+      ngroup = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-t") == 0)
+      ticks = strtoul(argv[++i], 0, 10);
+    else if(strcmp(argv[i], "-s") == 0)
+      srandom(atoi(argv[++i]));
+    else if(strcmp(argv[i], "-w") == 0)
+      pct = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-e") == 0)
+      maxerr = atof(argv[++i]);
+    else if(strcmp(argv[i], "-f") == 0)
+      trace = argv[++i];
+    else
+      usage();
+  }
+  if(n <= 0 || ngroup <= 0 || ngroup > NGROUP || ticks == 0 || pct < 0 || pct > 100)
+    usage();
+
+  // as procinit(): every CPU's queues, one online CPU
+  for(i = 0; i < NCPU; i++)
+    for(g = 0; g < NGROUP; g++)
+      cpus[i].rq[g].cpu = &cpus[i];
+  cpus[0].online = 1;
+  for(g = 0; g < NGROUP; g++){
+    groups[g].nice = 20;
+    groups[g].weight = weight_table[20];
+  }
+
+  if(trace)
+    readtrace(trace);
+  else
+    synthesize(n, pct);
+  if(ntask == 0)
+    usage();
+  sleepers = malloc(ntask * sizeof(*sleepers));
+  if(sleepers == 0)
+    panic("out of memory");
+
+  run(ticks * 1000);
+  return report(ticks);
+}
@@ -0,0 +1,124 @@
+// Check the kernel's page accounting.
+//
+// usage: memstat
+//
+// Prints the page counts memstat() returns and checks them:
+// the kinds of page add up to the total, and every count comes
+// back to where it was after children are forked and reaped,
+// and after pipes are opened, used and closed. Exits 1 if not.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define NROUND 10
+
+int failed;
+
+static void
+show(char *what, struct memstat *st)
+{
+  printf("memstat %s: total=%ld free=%ld user=%ld pagetable=%ld pipe=%ld kernel=%ld\n",
+         what, st->total, st->free, st->user, st->pagetable, st->pipe,
+         st->kernel);
+}
+
+// read the counts, and check that they add up.
+static void
+get(struct memstat *st)
+{
+  uint64 sum;
+
+  if(memstat(st) < 0){
+    printf("memstat: memstat failed\n");
+    exit(1);
+  }
+  sum = st->free + st->user + st->pagetable + st->pipe + st->kernel;
+  if(sum != st->total){
+    printf("memstat: counts add up to %ld, not %ld\n", sum, st->total);
+    failed = 1;
+  }
+}
+
+static void
+same(char *what, struct memstat *before, struct memstat *after)
+{
+  if(before->free != after->free || before->user != after->user ||
+     before->pagetable != after->pagetable || before->pipe != after->pipe ||
+     before->kernel != after->kernel){
+    printf("memstat: counts changed after %s\n", what);
+    show("before", before);
+    show("after", after);
+    failed = 1;
+  }
+}
+
+static void
+forkexit(void)
+{
+  int pid;
+
+  if((pid = fork()) < 0){
+    printf("memstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+    exit(0);
+  if(wait(0) != pid){
+    printf("memstat: wait failed\n");
+    exit(1);
+  }
+}
+
+static void
+pipeuse(void)
+{
+  int fds[2];
+  char c = 'x';
+
+  if(pipe(fds) < 0){
+    printf("memstat: pipe failed\n");
+    exit(1);
+  }
+  if(write(fds[1], &c, 1) != 1 || read(fds[0], &c, 1) != 1){
+    printf("memstat: pipe i/o failed\n");
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct memstat before, after;
+  int i;
+
+  get(&before);
+  show("start", &before);
+
+  // the kernel may keep memory it makes for the first fork or
+  // pipe (struct procs, say) for reuse; start counting after.
+  forkexit();
+  pipeuse();
+
+  get(&before);
+  for(i = 0; i < NROUND; i++)
+    forkexit();
+  get(&after);
+  same("fork/exit", &before, &after);
+
+  get(&before);
+  for(i = 0; i < NROUND; i++)
+    pipeuse();
+  get(&after);
+  same("pipe open/close", &before, &after);
+
+  if(failed){
+    printf("memstat: FAIL\n");
+    exit(1);
+  }
+  printf("memstat: OK\n");
+  exit(0);
+}
@@ -0,0 +1,297 @@
+// Scheduler benchmarks.
+//
+// usage: schedbench [pingpong|fairness|wakeup|fork]
+//
+// Runs the named benchmark, or all of them. Every result is one
+// line of key=value pairs after "schedbench <test>", so runs
+// under different schedulers or CPUS settings can be compared
+// by script. Times are in time CSR cycles; the header line gives
+// the number of cycles per tick (tickcycles).
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define PINGPONG_ITERS 2000
+#define FORK_ITERS     200
+#define WAKEUP_ITERS   50
+#define FAIR_HOGS      6
+#define FAIR_TICKS     200
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+// nice values of the fairness hogs, and their weights from
+// weight_table in kernel/eevdf.c.
+static int fair_nice[] = { 15, 20, 25 };
+static int fair_weight[] = { 3121, 1024, 335 };
+
+int ncpu;
+int allcpus;  // affinity mask of the online CPUs
+
+static inline uint64
+rdtime(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
+// find the online CPUs: setaffinity() refuses masks without one.
+static void
+probecpus(void)
+{
+  int i;
+
+  for(i = 0; i < 31; i++){
+    if(setaffinity(getpid(), 1 << i) == 0){
+      allcpus |= 1 << i;
+      ncpu++;
+    }
+  }
+  setaffinity(getpid(), allcpus);
+}
+
+// spin until time CSR reaches end, counting iterations.
+static uint64
+spin(uint64 end)
+{
+  uint64 n = 0;
+
+  while(rdtime() < end)
+    n++;
+  return n;
+}
+
+// round trips of one byte between two processes over pipes:
+// each is two context switches when they share a CPU.
+static void
+pingpong(int pinned)
+{
+  int ab[2], ba[2];
+  char c = 0;
+  uint64 t0, t1;
+  int i, pid;
+
+  if(pipe(ab) < 0 || pipe(ba) < 0){
+    fprintf(2, "schedbench: pipe failed\n");
+    exit(1);
+  }
+  if(pinned)
+    setaffinity(getpid(), 1);
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "schedbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(ab[1]);
+    close(ba[0]);
+    while(read(ab[0], &c, 1) == 1)
+      write(ba[1], &c, 1);
+    exit(0);
+  }
+  close(ab[0]);
+  close(ba[1]);
+
+  t0 = rdtime();
+  for(i = 0; i < PINGPONG_ITERS; i++){
+    write(ab[1], &c, 1);
+    read(ba[0], &c, 1);
+  }
+  t1 = rdtime();
+
+  close(ab[1]);
+  close(ba[0]);
+  wait(0);
+  setaffinity(getpid(), allcpus);
+
+  printf("schedbench pingpong pinned=%d iters=%d cycles=%lu cycles_per_roundtrip=%lu\n",
+         pinned, PINGPONG_ITERS, t1 - t0, (t1 - t0) / PINGPONG_ITERS);
+}
+
+// CPU hogs at mixed nice values pinned to one CPU: each one's
+// share of the work done should match its share of the weight.
+static void
+fairness(void)
+{
+  int fds[2], go[2];
+  uint64 count[FAIR_HOGS], total = 0, start;
+  long weight = 0, err, maxerr = 0;
+  int i, pid;
+
+  if(pipe(fds) < 0 || pipe(go) < 0){
+    fprintf(2, "schedbench: pipe failed\n");
+    exit(1);
+  }
+  setaffinity(getpid(), 1);
+
+  for(i = 0; i < FAIR_HOGS; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "schedbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      setnice(getpid(), fair_nice[i % NELEM(fair_nice)]);
+      // wait for all hogs to exist, then count for the same interval
+      read(go[0], &start, sizeof(start));
+      spin(start);
+      count[i] = spin(start + (uint64)FAIR_TICKS * TICKINTERVAL);
+      write(fds[1], &i, sizeof(i));
+      write(fds[1], &count[i], sizeof(count[i]));
+      exit(0);
+    }
+  }
+  setaffinity(getpid(), allcpus);
+  close(fds[1]);
+
+  start = rdtime() + TICKINTERVAL;
+  for(i = 0; i < FAIR_HOGS; i++)
+    write(go[1], &start, sizeof(start));
+  close(go[0]);
+  close(go[1]);
+
+  for(i = 0; i < FAIR_HOGS; i++){
+    int hog;
+    read(fds[0], &hog, sizeof(hog));
+    read(fds[0], &count[hog], sizeof(count[hog]));
+  }
+  close(fds[0]);
+  for(i = 0; i < FAIR_HOGS; i++)
+    wait(0);
+
+  for(i = 0; i < FAIR_HOGS; i++){
+    total += count[i];
+    weight += fair_weight[i % NELEM(fair_weight)];
+  }
+  if(total == 0)
+    total = 1;
+
+  // shares in parts per million; error relative to the expected share
+  for(i = 0; i < FAIR_HOGS; i++){
+    long want = (long)fair_weight[i % NELEM(fair_weight)] * 1000000 / weight;
+    long got = (long)(count[i] * 1000000 / total);
+    err = (got - want) * 1000 / want;
+    if(err < 0)
+      err = -err;
+    if(err > maxerr)
+      maxerr = err;
+    printf("schedbench fairness hog=%d nice=%d want_ppm=%ld got_ppm=%ld err_permille=%ld\n",
+           i, fair_nice[i % NELEM(fair_nice)], want, got, err);
+  }
+  printf("schedbench fairness hogs=%d ticks=%d max_err_permille=%ld\n",
+         FAIR_HOGS, FAIR_TICKS, maxerr);
+}
+
+// how late pause(1) returns after its tick while every CPU is
+// busy with a hog.
+static void
+wakeup(void)
+{
+  int pids[32];
+  uint64 lat[WAKEUP_ITERS], t0, t1, due, sum = 0, tmp;
+  int i, j;
+
+  for(i = 0; i < ncpu; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      fprintf(2, "schedbench: fork failed\n");
+      exit(1);
+    }
+    if(pids[i] == 0){
+      for(;;)
+        ;
+    }
+  }
+
+  for(i = 0; i < WAKEUP_ITERS; i++){
+    t0 = rdtime();
+    pause(1);
+    t1 = rdtime();
+    due = (t0 / TICKINTERVAL + 1) * TICKINTERVAL;
+    lat[i] = t1 > due ? t1 - due : 0;
+    sum += lat[i];
+  }
+
+  for(i = 0; i < ncpu; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+
+  for(i = 1; i < WAKEUP_ITERS; i++){
+    tmp = lat[i];
+    for(j = i; j > 0 && lat[j-1] > tmp; j--)
+      lat[j] = lat[j-1];
+    lat[j] = tmp;
+  }
+  printf("schedbench wakeup hogs=%d iters=%d avg_cycles=%lu p50_cycles=%lu p90_cycles=%lu max_cycles=%lu\n",
+         ncpu, WAKEUP_ITERS, sum / WAKEUP_ITERS, lat[WAKEUP_ITERS / 2],
+         lat[WAKEUP_ITERS * 9 / 10], lat[WAKEUP_ITERS - 1]);
+}
+
+// fork a child that exits at once, and wait for it.
+static void
+forkexit(void)
+{
+  uint64 t0, t1;
+  int i, pid;
+
+  t0 = rdtime();
+  for(i = 0; i < FORK_ITERS; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "schedbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      exit(0);
+    wait(0);
+  }
+  t1 = rdtime();
+
+  printf("schedbench fork iters=%d cycles=%lu cycles_per_fork=%lu forks_per_tick=%lu\n",
+         FORK_ITERS, t1 - t0, (t1 - t0) / FORK_ITERS,
+         (uint64)FORK_ITERS * TICKINTERVAL / (t1 - t0));
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *test = argc > 1 ? argv[1] : "all";
+  int all = strcmp(test, "all") == 0;
+  int ran = 0;
+
+  if(argc > 2){
+    fprintf(2, "usage: schedbench [pingpong|fairness|wakeup|fork]\n");
+    exit(1);
+  }
+
+  probecpus();
+  printf("schedbench cpus=%d tickcycles=%d\n", ncpu, TICKINTERVAL);
+
+  if(all || strcmp(test, "pingpong") == 0){
+    pingpong(1);
+    pingpong(0);
+    ran = 1;
+  }
+  if(all || strcmp(test, "fairness") == 0){
+    fairness();
+    ran = 1;
+  }
+  if(all || strcmp(test, "wakeup") == 0){
+    wakeup();
+    ran = 1;
+  }
+  if(all || strcmp(test, "fork") == 0){
+    forkexit();
+    ran = 1;
+  }
+
+  if(!ran){
+    fprintf(2, "usage: schedbench [pingpong|fairness|wakeup|fork]\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,183 @@
+// Scheduler latency analyzer.
+//
+// usage: schedlat [ticks]
+//
+// Drains the kernel's scheduler trace (schedtrace()) every tick
+// for the given number of ticks (default 100), then prints, per
+// nice value, histograms of
+//   run delay:       runnable (woken, forked or preempted) until
+//                    switched in
+//   wakeup latency:  woken or forked until switched in
+// in milliticks. Run a workload in the background to measure it,
+// e.g. "mytest & schedlat 200".
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NEVENT  4096  // events drained at once
+#define NSLOT   128   // tracked processes (by pid)
+#define NNICE   40
+#define NBUCKET 16    // <1, 1, 2-3, 4-7, ... milliticks
+
+struct hist {
+  int count;
+  uint64 sum;         // milliticks
+  uint64 max;
+  int bucket[NBUCKET];
+};
+
+// per-process state: since when it has waited to run
+struct waiter {
+  int pid;
+  uint64 since;       // time CSR, 0 if not waiting
+  int woken;          // waiting since a wakeup or fork
+};
+
+struct schedevent ev[NEVENT];
+struct waiter waiters[NSLOT];
+struct hist rundelay[NNICE];
+struct hist wakelat[NNICE];
+int nevents;
+
+static void
+record(struct hist *h, uint64 cycles)
+{
+  uint64 mt = cycles * 1000 / TICKINTERVAL;
+  int b = 0;
+
+  while(b < NBUCKET - 1 && (1UL << b) <= mt)
+    b++;
+  h->bucket[b]++;
+  h->count++;
+  h->sum += mt;
+  if(mt > h->max)
+    h->max = mt;
+}
+
+// order events by time. each CPU's events already are,
+// so this is mostly merging a few sorted runs.
+static void
+sortevents(int n)
+{
+  struct schedevent e;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    e = ev[i];
+    for(j = i; j > 0 && ev[j-1].time > e.time; j--)
+      ev[j] = ev[j-1];
+    ev[j] = e;
+  }
+}
+
+static void
+replay(struct schedevent *e)
+{
+  struct waiter *w = &waiters[e->pid % NSLOT];
+  int nice = e->nice;
+
+  if(w->pid != e->pid){
+    w->pid = e->pid;
+    w->since = 0;
+  }
+  if(nice < 0 || nice >= NNICE)
+    return;
+
+  switch(e->type){
+  case TRACE_WAKEUP:
+  case TRACE_FORK:
+    w->since = e->time;
+    w->woken = 1;
+    break;
+  case TRACE_SWITCHOUT:
+    if(e->runnable){
+      w->since = e->time;
+      w->woken = 0;
+    } else {
+      w->since = 0;
+    }
+    break;
+  case TRACE_SWITCHIN:
+    if(w->since && e->time >= w->since){
+      record(&rundelay[nice], e->time - w->since);
+      if(w->woken)
+        record(&wakelat[nice], e->time - w->since);
+    }
+    w->since = 0;
+    break;
+  case TRACE_EXIT:
+    w->since = 0;
+    break;
+  }
+}
+
+static void
+drain(void)
+{
+  int n, i;
+
+  while((n = schedtrace(ev, NEVENT)) > 0){
+    sortevents(n);
+    for(i = 0; i < n; i++)
+      replay(&ev[i]);
+    nevents += n;
+    if(n < NEVENT)
+      break;
+  }
+  if(n < 0){
+    fprintf(2, "schedlat: schedtrace failed\n");
+    exit(1);
+  }
+}
+
+static void
+printhist(char *what, int nice, struct hist *h)
+{
+  int b;
+
+  if(h->count == 0)
+    return;
+  printf("%s, nice %d: %d samples, avg %lu, max %lu milliticks\n",
+         what, nice, h->count, h->sum / h->count, h->max);
+  for(b = 0; b < NBUCKET; b++){
+    if(h->bucket[b] == 0)
+      continue;
+    if(b == 0)
+      printf("  <1\t\t%d\n", h->bucket[b]);
+    else if(b == NBUCKET - 1)
+      printf("  >=%lu\t\t%d\n", 1UL << (b - 1), h->bucket[b]);
+    else
+      printf("  %lu-%lu\t\t%d\n", 1UL << (b - 1), (1UL << b) - 1, h->bucket[b]);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ticks = 100;
+  int i;
+
+  if(argc > 2 || (argc == 2 && (ticks = atoi(argv[1])) <= 0)){
+    fprintf(2, "usage: schedlat [ticks]\n");
+    exit(1);
+  }
+
+  // forget what happened before we started
+  while(schedtrace(ev, NEVENT) == NEVENT)
+    ;
+
+  for(i = 0; i < ticks; i++){
+    pause(1);
+    drain();
+  }
+
+  printf("%d events over %d ticks\n", nevents, ticks);
+  for(i = 0; i < NNICE; i++){
+    printhist("run delay", i, &rundelay[i]);
+    printhist("wakeup latency", i, &wakelat[i]);
+  }
+  exit(0);
+}
@@ -0,0 +1,174 @@
+// Process monitor.
+//
+// usage: top [ticks [count]]
+//
+// Samples the process table (procsnap()) every ticks ticks
+// (default 100), count times (default 10), and lists the
+// processes by their share of a CPU since the last sample,
+// busiest first. A process running on two CPUs' worth of time
+// would show 200%. The header gives the load averages and how
+// the CPUs split their time between user code, the kernel and
+// idling since the last sample (cpustat()).
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/procinfo.h"
+#include "kernel/cpustat.h"
+#include "user/user.h"
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+static char *states[] = {
+  "unused", "used", "sleep", "runble", "run", "zombie"
+};
+
+struct procinfo cur[NPROC], prev[NPROC];
+int ncur, nprev;
+struct cpustat cstat, pstat;
+int pct[NPROC];       // tenths of a percent, by index into cur
+int order[NPROC];
+
+static inline uint64
+rdtime(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
+static int
+snap(void)
+{
+  int n = procsnap(cur, NPROC);
+
+  if(n < 0){
+    fprintf(2, "top: procsnap failed\n");
+    exit(1);
+  }
+  if(cpustat(&cstat) < 0){
+    fprintf(2, "top: cpustat failed\n");
+    exit(1);
+  }
+  return n;
+}
+
+// load average as d.dd
+static void
+printload(uint64 load)
+{
+  uint64 hundredths = (load * 100 + FIXED_1 / 2) / FIXED_1;
+
+  printf(" %lu.%lu%lu", hundredths / 100, hundredths / 10 % 10, hundredths % 10);
+}
+
+// the CPUs' user, kernel and idle time since the previous
+// sample, in tenths of a percent of their total.
+static void
+showcpu(void)
+{
+  uint64 user = 0, kernel = 0, idle = 0, total;
+  int i;
+
+  for(i = 0; i < cstat.ncpu; i++){
+    user += cstat.cpu[i].user - pstat.cpu[i].user;
+    kernel += cstat.cpu[i].kernel - pstat.cpu[i].kernel;
+    idle += cstat.cpu[i].idle - pstat.cpu[i].idle;
+  }
+  total = user + kernel + idle;
+  if(total == 0)
+    total = 1;
+  user = user * 1000 / total;
+  kernel = kernel * 1000 / total;
+  idle = idle * 1000 / total;
+
+  printf("load");
+  for(i = 0; i < 3; i++)
+    printload(cstat.load[i]);
+  printf(", %d cpus: %lu.%lu%% user %lu.%lu%% kernel %lu.%lu%% idle\n",
+         cstat.ncpu, user / 10, user % 10, kernel / 10, kernel % 10,
+         idle / 10, idle % 10);
+}
+
+// runtime of pid at the previous sample, or 0 if it is new
+static uint64
+prevruntime(int pid)
+{
+  int i;
+
+  for(i = 0; i < nprev; i++)
+    if(prev[i].pid == pid)
+      return prev[i].runtime;
+  return 0;
+}
+
+static void
+show(uint64 elapsed)
+{
+  struct procinfo *r;
+  uint64 base;
+  int i, j, tmp, total = 0;
+
+  for(i = 0; i < ncur; i++){
+    base = prevruntime(cur[i].pid);
+    pct[i] = 0;
+    if(elapsed > 0 && cur[i].runtime > base)
+      pct[i] = (cur[i].runtime - base) * 1000 / elapsed;
+    total += pct[i];
+    order[i] = i;
+  }
+
+  // busiest first
+  for(i = 1; i < ncur; i++){
+    tmp = order[i];
+    for(j = i; j > 0 && pct[order[j-1]] < pct[tmp]; j--)
+      order[j] = order[j-1];
+    order[j] = tmp;
+  }
+
+  printf("\n%d processes, %d.%d%% cpu over %lu milliticks\n",
+         ncur, total / 10, total % 10, elapsed);
+  showcpu();
+  printf("pid\tname\tstate\tnice\tcpu\t%%cpu\truntime\tsz\n");
+  for(i = 0; i < ncur; i++){
+    r = &cur[order[i]];
+    printf("%d\t%s\t%s\t%d\t%d\t%d.%d\t%lu\t%lu\n",
+           r->pid, r->name,
+           (uchar)r->state < NELEM(states) ? states[(uchar)r->state] : "???",
+           r->nice, r->cpu, pct[order[i]] / 10, pct[order[i]] % 10,
+           r->runtime, r->sz);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ticks = 100, count = 10;
+  uint64 t0, t1;
+  int i;
+
+  if(argc > 3 ||
+     (argc > 1 && (ticks = atoi(argv[1])) <= 0) ||
+     (argc > 2 && (count = atoi(argv[2])) <= 0)){
+    fprintf(2, "usage: top [ticks [count]]\n");
+    exit(1);
+  }
+
+  nprev = snap();
+  memmove(prev, cur, nprev * sizeof(cur[0]));
+  pstat = cstat;
+  t0 = rdtime();
+
+  for(i = 0; i < count; i++){
+    pause(ticks);
+    ncur = snap();
+    t1 = rdtime();
+    show((t1 - t0) * 1000 / TICKINTERVAL);
+
+    memmove(prev, cur, ncur * sizeof(cur[0]));
+    nprev = ncur;
+    pstat = cstat;
+    t0 = t1;
+  }
+  exit(0);
+}
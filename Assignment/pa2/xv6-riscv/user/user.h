@@ -1,6 +1,10 @@
 #define SBRK_ERROR ((char *)-1)
 
 struct stat;
+struct memstat;
+struct schedevent;
+struct procinfo;
+struct cpustat;
 
 // system calls
 int fork(void);
@@ -30,6 +34,19 @@ int setnice(int, int);
 void ps(int);
 int meminfo(void);
 int waitpid(int);
+int getslice(int);
+int setslice(int, int);
+int schedtrace(struct schedevent*, int);
+int getgroup(int);
+int setgroup(int, int);
+int setgroupnice(int, int);
+int getaffinity(int);
+int setaffinity(int, int);
+int getscheduler(int, int*);
+int setscheduler(int, int, int);
+int procsnap(struct procinfo*, int);
+int cpustat(struct cpustat*);
+int memstat(struct memstat*);
 
 // ulib.c
 int stat(const char*, struct stat*);
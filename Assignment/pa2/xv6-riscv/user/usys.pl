@@ -48,3 +48,16 @@ entry("setnice");
 entry("ps");
 entry("meminfo");
 entry("waitpid");
+entry("getslice");
+entry("setslice");
+entry("schedtrace");
+entry("getgroup");
+entry("setgroup");
+entry("setgroupnice");
+entry("getaffinity");
+entry("setaffinity");
+entry("getscheduler");
+entry("setscheduler");
+entry("procsnap");
+entry("cpustat");
+entry("memstat");
@@ -130,12 +130,12 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in table: an entry in the inode table
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a table entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in table: ip->ref tracks the number of
+//   in-memory pointers to a table entry (open files and
+//   current directories). iget() finds or creates an entry
+//   and increments its ref; iput() decrements ref, and
+//   frees the entry when ref reaches zero. Entries come
+//   from the slab allocator, so the table has no fixed size.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   table entry is only correct when ip->valid is 1.
@@ -166,9 +166,10 @@ bfree(int dev, uint b)
 // multi-step atomic operations.
 //
 // The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// entries and the list linking them. Since ip->ref decides when
+// an entry is freed, and ip->dev and ip->inum indicate which
+// i-node an entry holds, one must hold itable.lock while using
+// any of those fields.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -176,18 +177,23 @@ bfree(int dev, uint b)
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *head;          // entries with ref > 0
+  struct kmem_cache *cache;    // inode objects
 } itable;
 
+// runs once per inode object; inodes are freed
+// with their sleep-lock released.
+static void
+inodector(void *ip)
+{
+  initsleeplock(&((struct inode*)ip)->lock, "inode");
+}
+
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  itable.cache = kmem_cache_create("inode", sizeof(struct inode), inodector);
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -247,31 +253,32 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  for(ip = itable.head; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
+  // Allocate an inode entry.
+  if((ip = kmem_cache_alloc(itable.cache)) == 0)
     panic("iget: no inodes");
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->prev = 0;
+  ip->next = itable.head;
+  if(ip->next)
+    ip->next->prev = ip;
+  itable.head = ip;
   release(&itable.lock);
 
   return ip;
@@ -328,8 +335,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode table entry can
-// be recycled.
+// If that was the last reference, the inode table entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -359,7 +366,20 @@ iput(struct inode *ip)
   }
 
   ip->ref--;
+  if(ip->ref > 0){
+    release(&itable.lock);
+    return;
+  }
+
+  // last reference: take the entry out of the table.
+  if(ip->prev)
+    ip->prev->next = ip->next;
+  else
+    itable.head = ip->next;
+  if(ip->next)
+    ip->next->prev = ip->prev;
   release(&itable.lock);
+  kmem_cache_free(itable.cache, ip);
 }
 
 // Common idiom: unlock, then put.
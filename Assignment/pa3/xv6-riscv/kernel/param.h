@@ -1,8 +1,6 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
@@ -12,6 +10,8 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define KMEMNAME     16    // significant characters of a slab cache name
+#define TICKINTERVAL 1000000 // time CSR cycles between timer interrupts
 #define PROT_READ   0x1     // read protection
 #define PROT_WRITE  0x2     // write protection
 #define MAP_ANONYMOUS 0x1   // MAP_ANONYMOUS flag
@@ -15,7 +15,8 @@ struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
 
-struct mmap_area mmaps[64];
+// mmap_area objects, from the slab allocator
+static struct kmem_cache *mmapcache;
 
 struct proc *initproc;
 
@@ -24,6 +25,8 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void kick_idle(void);
+static void mmap_freeall(struct proc *p);
 extern int freepagespace(void); //int function to return number of free pages
 
 extern char trampoline[]; // trampoline.S
@@ -64,11 +67,8 @@ procinit(void)
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
   }
-  // initialize mmaps process
-  for(int i = 0; i < 64; i++)
-  {
-        mmaps[i].p = 0;
-  }
+  // cache for mmap regions
+  mmapcache = kmem_cache_create("mmap", sizeof(struct mmap_area), 0);
 }
 
 // Must be called with interrupts disabled,
@@ -289,64 +289,53 @@ kfork(void)
   }
   np->sz = p->sz;
 
-  // duplicate mmap entries of parent
-  for(i = 0; i < 64; i++) {
-    // find mmaps that is the parent process
-    if(mmaps[i].p == p) {
-        // find empty space
-        int j, found = 0;
-        for(j = 0; j < 64; j++) {
-            // find an empty array index
-            if(mmaps[j].p == 0) {
-                found = 1;
-                break;
-            }
-        }
-        // if no index found, error: kill child
-        if(found == 0) {
+  // duplicate mmap entries of parent, keeping their order
+  struct mmap_area **tail = &np->mmaps;
+  for(struct mmap_area *pm = p->mmaps; pm; pm = pm->next) {
+    // allocate child's entry, if fail release child
+    struct mmap_area *m = kmem_cache_alloc(mmapcache);
+    if(m == 0) {
+        mmap_freeall(np);
+        freeproc(np);
+        release(&np->lock);
+        return -1;
+    }
+
+    // copy parent's info
+    *m = *pm;
+    m->next = 0;
+    *tail = m;
+    tail = &m->next;
+
+    // copy file if exists
+    if(pm->f)
+        m->f = filedup(pm->f);
+
+    // now checking for pages, ensuring to copy parent's pages
+    for(uint64 va = pm->addr; va < pm->addr + pm->length; va += PGSIZE) {
+        // check and ensure that page exists
+        if(!ismapped(p->pagetable, va)) continue;
+        // walk and retrieve pte
+        pte_t *pte = walk(p->pagetable, va, 0);
+        // parent has a page mapped, then copy it
+        uint64 pa = PTE2PA(*pte);
+        char *page = kalloc();
+        // if fail to alloc, release child
+        if(page == 0) {
+            mmap_freeall(np);
             freeproc(np);
             release(&np->lock);
             return -1;
         }
-
-        // copy parent's info
-        mmaps[j].p = np;
-        mmaps[j].addr = mmaps[i].addr;
-        mmaps[j].length = mmaps[i].length;
-        mmaps[j].prot = mmaps[i].prot;
-        mmaps[j].flags = mmaps[i].flags;
-        mmaps[j].offset = mmaps[i].offset;
-
-        // copy file if exists
-        if(mmaps[i].f)
-            mmaps[j].f = filedup(mmaps[i].f);
-        else
-            mmaps[j].f = 0;
-
-        // now checking for pages, ensuring to copy parent's pages
-        for(uint64 va = mmaps[i].addr; va < mmaps[i].addr + mmaps[i].length; va += PGSIZE) {
-            // check and ensure that page exists
-            if(!ismapped(p->pagetable, va)) continue;
-            // walk and retrieve pte
-            pte_t *pte = walk(p->pagetable, va, 0);
-            // parent has a page mapped, then copy it
-            uint64 pa = PTE2PA(*pte);
-            char *page = kalloc();
-            // if fail to alloc, release child
-            if(page == 0) {
-                freeproc(np);
-                release(&np->lock);
-                return -1;
-            }
-            // copy parent's page to child
-            memmove(page, (char*)pa, PGSIZE);
-            // mappages of child process, exit if error occurs
-            if(mappages(np->pagetable, va, PGSIZE, (uint64)page, PTE_FLAGS(*pte)) < 0) {
-                kfree(page);
-                freeproc(np);
-                release(&np->lock);
-                return -1;
-            }
+        // copy parent's page to child
+        memmove(page, (char*)pa, PGSIZE);
+        // mappages of child process, exit if error occurs
+        if(mappages(np->pagetable, va, PGSIZE, (uint64)page, PTE_FLAGS(*pte)) < 0) {
+            kfree(page);
+            mmap_freeall(np);
+            freeproc(np);
+            release(&np->lock);
+            return -1;
         }
     }
   }
@@ -376,6 +365,7 @@ kfork(void)
   acquire(&np->lock);
   np->state = RUNNABLE;
   release(&np->lock);
+  kick_idle();
 
   return pid;
 }
@@ -416,32 +406,7 @@ kexit(int status)
   }
 
   // close mmap regions
-  for(int i = 0; i < 64; i++)
-  {
-    if(mmaps[i].p == p)
-    {
-        // unmap any mapped pages
-        for(uint64 va = mmaps[i].addr; va < mmaps[i].addr + mmaps[i].length; va += PGSIZE)
-        {  
-            // ensure page is mapped
-            if(ismapped(p->pagetable, va))
-            {
-                // retrieve pte
-                pte_t *pte = walk(p->pagetable, va, 0);
-                // free physical address
-                uint64 pa = PTE2PA(*pte);
-                kfree((void*)pa);
-                // unmap page
-                uvmunmap(p->pagetable, va, 1, 0);
-            }
-        }
-        // delete file
-        if(mmaps[i].f)
-            fileclose(mmaps[i].f);
-        // reset index memory
-        memset(&mmaps[i], 0, sizeof(mmaps[i]));
-    }
-  }
+  mmap_freeall(p);
 
   begin_op();
   iput(p->cwd);
@@ -516,6 +481,24 @@ kwait(uint64 addr)
   }
 }
 
+// Interrupt an idle hart, if there is one, so that it runs a
+// process that was just made RUNNABLE instead of waiting in wfi
+// for a timer that idle harts no longer arm. The fence pairs
+// with the one in scheduler() after it sets c->idle.
+static void
+kick_idle(void)
+{
+  struct cpu *c;
+
+  __sync_synchronize();
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->idle){
+      sendipi(c - cpus);
+      return;
+    }
+  }
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -539,6 +522,12 @@ scheduler(void)
     intr_on();
     intr_off();
 
+    // count as idle from before the scan, so that a process
+    // made runnable behind it sees this hart idle and kicks it
+    // out of wfi (see kick_idle()).
+    c->idle = 1;
+    __sync_synchronize();
+
     int found = 0;
     for(p = proc; p < &proc[NPROC]; p++) {
       acquire(&p->lock);
@@ -548,6 +537,10 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+        c->idle = 0;
+        // interrupt it when its time slice runs out
+        c->slice_end = r_time() + TICKINTERVAL;
+        settimer();
         swtch(&c->context, &p->context);
 
         // Process is done running for now.
@@ -559,6 +552,9 @@ scheduler(void)
     }
     if(found == 0) {
       // nothing to run; stop running on this core until an interrupt.
+      // no timer interrupt unless a pause() sleeper is due;
+      // kick_idle() interrupts it when a process becomes runnable.
+      settimer();
       asm volatile("wfi");
     }
   }
@@ -676,16 +672,20 @@ void
 wakeup(void *chan)
 {
   struct proc *p;
+  int woken = 0;
 
   for(p = proc; p < &proc[NPROC]; p++) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        woken = 1;
       }
       release(&p->lock);
     }
   }
+  if(woken)
+    kick_idle();
 }
 
 // Kill the process with the given pid.
@@ -703,6 +703,9 @@ kkill(int pid)
       if(p->state == SLEEPING){
         // Wake process from sleep().
         p->state = RUNNABLE;
+        release(&p->lock);
+        kick_idle();
+        return 0;
       }
       release(&p->lock);
       return 0;
@@ -1010,6 +1013,51 @@ waitpid(int pid)
     }
 }
 
+// free the mapped pages of mmap entry m of process p,
+// close its file and free the entry itself.
+// m must already be off p's list.
+static void
+mmap_release(struct proc *p, struct mmap_area *m)
+{
+    // free mapped pages
+    for(uint64 va = m->addr; va < m->addr + m->length; va += PGSIZE)
+    {
+        // ensure page is mapped
+        if(ismapped(p->pagetable, va))
+        {
+            // retrieve pte
+            pte_t *pte = walk(p->pagetable, va, 0);
+            // free physical address
+            uint64 pa = PTE2PA(*pte);
+            kfree((void*)pa);
+            // unmap page
+            uvmunmap(p->pagetable, va, 1, 0);
+        }
+    }
+    // close file if it exists
+    if(m->f)
+    {
+        fileclose(m->f);
+    }
+    kmem_cache_free(mmapcache, m);
+}
+
+// release all mmap regions of process p.
+// called by exit, and by fork for a half-built child; the
+// child's files are shared with its parent, so closing
+// them there never drops the last reference.
+static void
+mmap_freeall(struct proc *p)
+{
+    struct mmap_area *m;
+
+    while((m = p->mmaps) != 0)
+    {
+        p->mmaps = m->next;
+        mmap_release(p, m);
+    }
+}
+
 // memory mapping
 uint64
 mmap(uint64 addr, int length, int prot, int flags, int fd, int offset)
@@ -1066,20 +1114,10 @@ mmap(uint64 addr, int length, int prot, int flags, int fd, int offset)
         }
     }
     
-    // find empty mmaps index
-    int idx, found = 0;
-    for(int i = 0; i < 64; i++)
-    {
-        // empty mmaps index found
-        if(mmaps[i].p == 0)
-        {
-            idx = i;
-            found = 1;
-            break;
-        }
-    }
-    // mmaps full error
-    if(found == 0)
+    // allocate mmap entry
+    struct mmap_area *m = kmem_cache_alloc(mmapcache);
+    // out of memory error
+    if(m == 0)
     {
         return 0;
     }
@@ -1099,6 +1137,7 @@ mmap(uint64 addr, int length, int prot, int flags, int fd, int offset)
             // kalloc, if mem = 0, kalloc failed
             if((mem = kalloc()) == 0)
             {
+                kmem_cache_free(mmapcache, m);
                 return 0;
             }
             // set memory
@@ -1120,6 +1159,7 @@ mmap(uint64 addr, int length, int prot, int flags, int fd, int offset)
                 if(fd < 0)
                 {
                     kfree(mem);
+                    kmem_cache_free(mmapcache, m);
                     return 0;
                 }
             }
@@ -1133,19 +1173,21 @@ mmap(uint64 addr, int length, int prot, int flags, int fd, int offset)
             {
                 // if error, free pages
                 kfree(mem);
+                kmem_cache_free(mmapcache, m);
                 return 0;
             }
         }
     }
     
-    // mmaps value updates
-    mmaps[idx].f = f;
-    mmaps[idx].addr = start_addr;
-    mmaps[idx].length = length;
-    mmaps[idx].offset = offset;
-    mmaps[idx].prot = prot;
-    mmaps[idx].flags = flags;
-    mmaps[idx].p = p;
+    // mmap entry updates, add to process's list
+    m->f = f;
+    m->addr = start_addr;
+    m->length = length;
+    m->offset = offset;
+    m->prot = prot;
+    m->flags = flags;
+    m->next = p->mmaps;
+    p->mmaps = m;
     
     
     return start_addr;
@@ -1155,7 +1197,7 @@ mmap(uint64 addr, int length, int prot, int flags, int fd, int offset)
 int munmap(uint64 addr)
 {
     struct proc *p = myproc();
-    int idx, found = 0;
+    struct mmap_area **pp, *m;
     
     // return 0 if size is not page-aligned
     if(addr % PGSIZE != 0)
@@ -1163,54 +1205,23 @@ int munmap(uint64 addr)
         return 0;
     }
 
-    // loop through mmaps array
-    for(int i = 0; i < 64; i++)
+    // find the process's entry starting at addr
+    for(pp = &p->mmaps; (m = *pp) != 0; pp = &m->next)
     {
-        // check if addr exists in array
-        if(addr == mmaps[i].addr)
+        if(m->addr == addr)
         {
-            // make sure index in array is currently valid
-            if(mmaps[i].p == p)
-            {
-                // if valid, set the new index
-                idx = i;
-                found = 1;
-                break;
-            }
+            break;
         }
     }
-    // if entry in array not found, error
-    if(found == 0)
+    // if entry not found, error
+    if(m == 0)
     {
         return -1;
     }
 
-    // free mapped pages
-    for(uint64 ptr = addr; ptr < addr + mmaps[idx].length; ptr += PGSIZE)
-    {
-        // walk through pagetable for pages
-        pte_t *pte = walk(p->pagetable, ptr, 0);
-        // pte is valid
-        if(pte && (*pte & PTE_V))
-        {
-            // retrieve physical address
-            uint64 pa = PTE2PA(*pte);
-            // free physical address
-            kfree((void*)pa);
-            // unmap
-            uvmunmap(p->pagetable, ptr, 1, 0);    
-        }
-    }
-
-    // close file if it exists
-    if(mmaps[idx].f)
-    {
-        fileclose(mmaps[idx].f);
-    }
-    // clear mmaps
-    memset(&mmaps[idx], 0, sizeof(mmaps[idx]));
-    // ensure p = 0
-    mmaps[idx].p = 0;
+    // unlink from list, then free pages, file and entry
+    *pp = m->next;
+    mmap_release(p, m);
     
     return 1;
 }
@@ -24,6 +24,8 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 slice_end;           // r_time() at which the running process's time slice ends.
+  int idle;                   // Looking for a process to run, or waiting in wfi.
 };
 
 extern struct cpu cpus[NCPU];
@@ -89,7 +91,7 @@ struct mmap_area {
     int offset;
     int prot;
     int flags;
-    struct proc *p; // the process with the mmap_area
+    struct mmap_area *next; // next area of the same process
 
 };
 
@@ -116,5 +118,6 @@ struct proc {
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct mmap_area *mmaps;     // mmap regions, newest first
   char name[16];               // Process name (debugging)
 };
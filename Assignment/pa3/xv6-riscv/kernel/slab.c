@@ -0,0 +1,285 @@
+// Slab allocator, for kernel objects smaller than a page.
+//
+// A kmem_cache hands out objects of one size. It carves them
+// out of slabs: pages from kalloc() that start with a struct
+// slab header, followed by as many objects as fit. The header
+// keeps a stack of the indexes of its free objects, rather than
+// linking them through the objects, so that a free object keeps
+// its contents. Slabs with free objects are on the cache's
+// partial list and slabs with none on its full list. A slab
+// whose objects are all free is given back to kalloc(), except
+// for one kept to absorb alloc/free cycles.
+//
+// The optional constructor runs on each object once, when its
+// slab is created. Objects are freed in their constructed state
+// (a lock released, say), so it need not run again.
+//
+// In front of the slabs, each CPU keeps up to SLAB_CPUCACHE free
+// objects of each cache, used with interrupts off and without a
+// lock. It refills from and flushes to the slabs SLAB_BATCH
+// objects at a time, under the cache's lock. Objects held there
+// keep their slabs from going empty, so when the last object in
+// use is freed, every CPU hands back all it holds: this one at
+// once, the others on their next call into the cache (see
+// cpu_drain()). Until then, a CPU pins at most SLAB_CPUCACHE
+// objects' slabs.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "defs.h"
+
+#define NKMEMCACHE    8    // caches
+#define SLAB_MAXOBJ   128  // objects per slab, at most
+#define SLAB_MINSIZE  32   // objects are at least this big
+#define SLAB_CPUCACHE 16   // free objects each CPU keeps per cache
+#define SLAB_BATCH    8    // objects moved to or from a CPU at once
+
+struct slab {
+  struct kmem_cache *cache;
+  struct slab *next;            // in the cache's partial or full list
+  struct slab *prev;
+  int nfree;                    // free objects
+  uchar free[SLAB_MAXOBJ];      // their indexes; the next is free[nfree-1]
+};
+
+#define SLAB_HDR ((sizeof(struct slab) + 7) & ~7)
+
+struct kmem_cache {
+  char *name;
+  uint size;                    // object size, rounded up
+  int perslab;                  // objects per slab
+  void (*ctor)(void*);          // constructor, or 0
+
+  struct spinlock lock;         // protects the slab lists
+  struct slab *partial;         // slabs with some objects free
+  struct slab *full;            // slabs with no objects free
+  struct slab *empty;           // a slab with every object free, or 0
+
+  int inuse;                    // objects allocated and not freed; atomic
+  uint drain;                   // times inuse went to 0; atomic
+
+  struct {
+    int n;
+    void *obj[SLAB_CPUCACHE];
+    uint drain;                 // the cache's drain when last flushed
+  } cpu[NCPU];                  // free objects; their CPU only, interrupts off
+};
+
+static struct kmem_cache caches[NKMEMCACHE];
+static int ncaches;
+static struct spinlock cachelock;
+
+void
+slabinit(void)
+{
+  initlock(&cachelock, "kmem_cache");
+}
+
+// Make a cache of objects of the given size, constructed by
+// ctor if it is not 0. Panics if out of caches or if the size
+// does not fit a slab; caches are made once, at boot.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size, void (*ctor)(void*))
+{
+  struct kmem_cache *c;
+
+  size = (size + 7) & ~7;
+  if(size < SLAB_MINSIZE)
+    size = SLAB_MINSIZE;
+  if(size > PGSIZE - SLAB_HDR)
+    panic("kmem_cache_create: size");
+
+  acquire(&cachelock);
+  if(ncaches >= NKMEMCACHE)
+    panic("kmem_cache_create: no caches");
+  c = &caches[ncaches++];
+  release(&cachelock);
+
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - SLAB_HDR) / size;
+  if(c->perslab > SLAB_MAXOBJ)
+    c->perslab = SLAB_MAXOBJ;
+  c->ctor = ctor;
+  initlock(&c->lock, name);
+  return c;
+}
+
+static void
+slab_push(struct slab **list, struct slab *s)
+{
+  s->prev = 0;
+  s->next = *list;
+  if(s->next)
+    s->next->prev = s;
+  *list = s;
+}
+
+static void
+slab_remove(struct slab **list, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    *list = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+}
+
+static void*
+slab_obj(struct slab *s, int i)
+{
+  return (char*)s + SLAB_HDR + i * s->cache->size;
+}
+
+// a new slab of constructed objects, or 0 if out of memory.
+// c->lock must be held.
+static struct slab*
+slab_create(struct kmem_cache *c)
+{
+  struct slab *s;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->next = s->prev = 0;
+  s->nfree = c->perslab;
+  // hand out the lowest addresses first
+  for(i = 0; i < c->perslab; i++){
+    s->free[i] = c->perslab - 1 - i;
+    if(c->ctor)
+      c->ctor(slab_obj(s, i));
+  }
+  return s;
+}
+
+// take a free object from the slabs, making a slab if need be.
+// returns 0 if out of memory. c->lock must be held.
+static void*
+slab_alloc(struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  if((s = c->partial) == 0){
+    if((s = c->empty) != 0)
+      c->empty = 0;
+    else if((s = slab_create(c)) == 0)
+      return 0;
+    slab_push(&c->partial, s);
+  }
+
+  obj = slab_obj(s, s->free[--s->nfree]);
+  if(s->nfree == 0){
+    slab_remove(&c->partial, s);
+    slab_push(&c->full, s);
+  }
+  return obj;
+}
+
+// return obj to its slab. c->lock must be held.
+static void
+slab_free(struct kmem_cache *c, void *obj)
+{
+  struct slab *s = (struct slab*)PGROUNDDOWN((uint64)obj);
+  uint64 off = (char*)obj - (char*)s - SLAB_HDR;
+
+  if(s->cache != c || off % c->size != 0 || off / c->size >= c->perslab)
+    panic("kmem_cache_free");
+
+  if(s->nfree == 0){
+    slab_remove(&c->full, s);
+    slab_push(&c->partial, s);
+  }
+  s->free[s->nfree++] = off / c->size;
+
+  if(s->nfree == c->perslab){
+    slab_remove(&c->partial, s);
+    if(c->empty == 0)
+      c->empty = s;
+    else
+      kfree((void*)s);
+  }
+}
+
+// flush all of CPU id's free objects to the slabs if c has
+// gone fully free since it last did. interrupts must be off.
+static void
+cpu_drain(struct kmem_cache *c, int id)
+{
+  uint drain = __atomic_load_n(&c->drain, __ATOMIC_RELAXED);
+
+  if(c->cpu[id].drain == drain)
+    return;
+  c->cpu[id].drain = drain;
+  acquire(&c->lock);
+  while(c->cpu[id].n > 0)
+    slab_free(c, c->cpu[id].obj[--c->cpu[id].n]);
+  release(&c->lock);
+}
+
+// Allocate a constructed object from c.
+// Returns 0 if out of memory.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  void *obj = 0;
+  int id;
+
+  push_off();
+  id = cpuid();
+  cpu_drain(c, id);
+  if(c->cpu[id].n == 0){
+    acquire(&c->lock);
+    while(c->cpu[id].n < SLAB_BATCH && (obj = slab_alloc(c)) != 0)
+      c->cpu[id].obj[c->cpu[id].n++] = obj;
+    release(&c->lock);
+  }
+  obj = 0;
+  if(c->cpu[id].n > 0){
+    obj = c->cpu[id].obj[--c->cpu[id].n];
+    __atomic_add_fetch(&c->inuse, 1, __ATOMIC_RELAXED);
+  }
+  pop_off();
+  return obj;
+}
+
+// Free obj, allocated from c, in its constructed state.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  int id;
+
+  push_off();
+  id = cpuid();
+  if(c->cpu[id].n == SLAB_CPUCACHE){
+    acquire(&c->lock);
+    while(c->cpu[id].n > SLAB_CPUCACHE - SLAB_BATCH)
+      slab_free(c, c->cpu[id].obj[--c->cpu[id].n]);
+    release(&c->lock);
+  }
+  c->cpu[id].obj[c->cpu[id].n++] = obj;
+  if(__atomic_sub_fetch(&c->inuse, 1, __ATOMIC_RELAXED) == 0)
+    __atomic_add_fetch(&c->drain, 1, __ATOMIC_RELAXED);
+  cpu_drain(c, id);
+  pop_off();
+}
+
+// The number of objects in use in the cache called name,
+// or -1 if there is none.
+int
+kmem_cache_inuse(char *name)
+{
+  int i;
+
+  // caches are all made at boot, before any caller
+  for(i = 0; i < ncaches; i++)
+    if(strncmp(caches[i].name, name, KMEMNAME) == 0)
+      return __atomic_load_n(&caches[i].inuse, __ATOMIC_RELAXED);
+  return -1;
+}
@@ -110,6 +110,7 @@ extern uint64 sys_waitpid(void);
 extern uint64 sys_mmap(void);
 extern uint64 sys_munmap(void);
 extern uint64 sys_freemem(void);
+extern uint64 sys_slabinuse(void);
 
 
 // An array mapping syscall numbers from syscall.h
@@ -145,6 +146,7 @@ static uint64 (*syscalls[])(void) = {
 [SYS_mmap]    sys_mmap,
 [SYS_munmap]  sys_munmap,
 [SYS_freemem] sys_freemem,
+[SYS_slabinuse] sys_slabinuse,
 };
 
 void
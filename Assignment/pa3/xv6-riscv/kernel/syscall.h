@@ -29,3 +29,4 @@
 #define SYS_mmap    28
 #define SYS_munmap  29
 #define SYS_freemem 30
+#define SYS_slabinuse 31
@@ -72,12 +72,17 @@ sys_pause(void)
   if(n < 0)
     n = 0;
   acquire(&tickslock);
+  tickupdate();
   ticks0 = ticks;
   while(ticks - ticks0 < n){
     if(killed(myproc())){
       release(&tickslock);
       return -1;
     }
+    // there is no periodic tick; ask for a timer
+    // interrupt when this sleep is due.
+    if(tickexpiry == 0 || ticks0 + n < tickexpiry)
+      tickexpiry = ticks0 + n;
     sleep(&ticks, &tickslock);
   }
   release(&tickslock);
@@ -101,6 +106,7 @@ sys_uptime(void)
   uint xticks;
 
   acquire(&tickslock);
+  tickupdate();
   xticks = ticks;
   release(&tickslock);
   return xticks;
@@ -207,3 +213,16 @@ sys_freemem(void)
 {
     return freemem();
 }
+
+// return the number of objects in use in a slab cache
+uint64
+sys_slabinuse(void)
+{
+    char name[KMEMNAME];
+
+    // get argument
+    if(argstr(0, name, KMEMNAME) < 0)
+        return -1;
+
+    return kmem_cache_inuse(name);
+}
@@ -8,14 +8,13 @@
 
 struct spinlock tickslock;
 uint ticks;
+uint tickexpiry;  // earliest tick a pause() sleeper waits for, or 0 if none
 
 extern char trampoline[], uservec[];
 
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
-extern struct mmap_area mmaps[64];
-
 extern int devintr();
 
 int page_fault_handler(struct proc *p, uint64 va, int write);
@@ -97,8 +96,9 @@ usertrap(void)
   if(killed(p))
     kexit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // give up the CPU if this is a timer interrupt
+  // and the time slice has run out.
+  if(which_dev == 2 && r_time() >= mycpu()->slice_end)
     yield();
 
   prepare_return();
@@ -168,8 +168,9 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0)
+  // give up the CPU if this is a timer interrupt
+  // and the time slice has run out.
+  if(which_dev == 2 && myproc() != 0 && r_time() >= mycpu()->slice_end)
     yield();
 
   // the yield() may have caused some traps to occur,
@@ -181,17 +182,55 @@ kerneltrap()
 void
 clockintr()
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
+  acquire(&tickslock);
+  tickupdate();
+  // wake pause() sleepers once the earliest of them is due;
+  // those that need to sleep longer ask again.
+  if(tickexpiry != 0 && ticks >= tickexpiry){
+    tickexpiry = 0;
     wakeup(&ticks);
-    release(&tickslock);
   }
+  release(&tickslock);
 
   // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // the interrupt request.
+  settimer();
+}
+
+// bring ticks up to date with the time CSR. timer interrupts
+// no longer arrive once per tick, so ticks is derived from the
+// time rather than counted.
+// caller must hold tickslock.
+void
+tickupdate(void)
+{
+  ticks = r_time() / TICKINTERVAL;
+}
+
+// program this hart's next timer interrupt. there is no periodic
+// tick: interrupt when the running process's time slice ends or
+// when the earliest pause() sleeper is due, whichever is first.
+// an idle hart with no sleeper to wake is not interrupted at all.
+// interrupts must be disabled.
+void
+settimer(void)
+{
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+  uint64 when = -1;
+  uint expiry = tickexpiry;  // a stale read only costs an extra interrupt
+
+  if(c->proc != 0){
+    when = c->slice_end;
+    // the slice has already run out and the trap handler is
+    // about to yield; check back in a tick in case it doesn't.
+    if(when <= now)
+      when = now + TICKINTERVAL;
+  }
+  if(expiry != 0 && (uint64)expiry * TICKINTERVAL < when)
+    when = (uint64)expiry * TICKINTERVAL;
+
+  w_stimecmp(when);
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -229,8 +268,21 @@ devintr()
     // timer interrupt.
     clockintr();
     return 2;
+  } else if(scause == 0x8000000000000001L){
+    // supervisor software interrupt: another hart has made a
+    // process runnable while this one was idle, see sendipi().
+    w_sip(r_sip() & ~SIP_SSIP);
+    return 3;
   } else {
     return 0;
   }
 }
 
+// raise a supervisor software interrupt on hart,
+// via the ACLINT SSWI device.
+void
+sendipi(int hart)
+{
+  *(volatile uint32 *)SSWI_SETSSIP(hart) = 1;
+}
+
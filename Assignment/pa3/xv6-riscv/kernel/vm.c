@@ -21,8 +21,6 @@ extern char trampoline[]; // trampoline.S
 
 struct file;
 
-extern struct mmap_area mmaps[64];
-
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -41,6 +39,9 @@ kvmmake(void)
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
+  // ACLINT SSWI, for inter-processor interrupts
+  kvmmap(kpgtbl, SSWI, SSWI, PGSIZE, PTE_R | PTE_W);
+
   // map kernel text executable and read-only.
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
@@ -458,20 +459,15 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 int
 page_fault_handler(struct proc *p, uint64 va, int write)
 {
-    // find mmap index
+    // find mmap area
     struct mmap_area *m = 0;
     char* mem = 0;
-    for(int i = 0; i < 64; i++)
+    for(m = p->mmaps; m; m = m->next)
     {
-        // find current process in mmaps array
-        if(mmaps[i].p == p)
+        // check if the current va is within the area's address length
+        if(va >= m->addr && va < m->addr + m->length)
         {
-            // check if the current va is within the current process' address length
-            if(va >= mmaps[i].addr && va < mmaps[i].addr + mmaps[i].length)
-            {
-                m = &mmaps[i];
-                break;
-            }
+            break;
         }
     }
 
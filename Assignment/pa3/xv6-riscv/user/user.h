@@ -33,6 +33,7 @@ int waitpid(int);
 uint64 mmap(uint64, int, int, int, int, int);
 int munmap(uint64);
 int freemem(void);
+int slabinuse(const char*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -51,3 +51,4 @@ entry("waitpid");
 entry("mmap");
 entry("munmap");
 entry("freemem");
+entry("slabinuse");
@@ -0,0 +1,15 @@
+// CPU time and load averages, as returned by cpustat().
+
+#define FSHIFT  11            // bits of fraction in a load average
+#define FIXED_1 (1 << FSHIFT) // 1.0 in load average fixed point
+
+struct cpustat {
+  uint64 time;          // time CSR when the snapshot was taken
+  uint64 load[3];       // 1, 5 and 15 minute load averages, FSHIFT fixed point
+  int ncpu;             // number of entries of cpu[] filled in
+  struct {
+    uint64 user;        // time CSR cycles running user code
+    uint64 kernel;      // ... running in the kernel
+    uint64 idle;        // ... waiting in scheduler() with nothing to run
+  } cpu[NCPU];
+};
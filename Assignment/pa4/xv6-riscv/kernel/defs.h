@@ -22,6 +22,12 @@ void            consoleinit(void);
 void            consoleintr(int);
 void            consputc(int);
 
+// cpustat.c
+void            cpustatinit(void);
+void            cpuacct(int);
+void            loadupdate(void);
+int             cpustat(uint64);
+
 // exec.c
 int             exec(char*, char**);
 
@@ -66,6 +72,9 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+struct page*    pa2page(uint64);
 // pa4
 void            swapinit(void);
 void            lru_add(struct page*);
@@ -115,6 +124,7 @@ void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             nr_running(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
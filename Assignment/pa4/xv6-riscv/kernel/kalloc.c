@@ -1,6 +1,19 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or with kalloc_order() physically contiguous runs of them.
+//
+// Free memory is kept by a buddy allocator. A block of order k
+// is 2^k pages, aligned to its size, so that its buddy (the
+// other half of the order k+1 block holding it) is at
+// pa ^ (PGSIZE << k). Allocation splits the smallest block that
+// fits; freeing merges a block with its buddy while the buddy
+// is free too.
+//
+// Each CPU keeps a cache of free pages that kalloc() and kfree()
+// use without touching the buddy allocator. A cache refills from
+// and drains to it KCACHE_BATCH pages at a time, so kmem.lock is
+// taken once per batch rather than per page.
 
 #include "types.h"
 #include "param.h"
@@ -16,17 +29,41 @@ int swap_out(void);
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+// a free block, or a free page in a CPU's cache (next only).
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
+#define MAXORDER   10      // largest block: 2^MAXORDER pages (4 MB)
+#define BLOCK_FREE 0x80    // in struct page's free: first page of a
+                           // free block, whose order is in the low bits
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *free[MAXORDER+1];  // free blocks of each order
+  uint64 start;                  // lowest address it hands out
 } kmem;
 
-// pa4: struct for page control
-struct page pages[PHYSTOP/PGSIZE];
+#define KCACHE_BATCH 16  // pages moved between a cache and kmem at once
+#define KCACHE_HIGH  64  // a cache this full drains a batch
+
+// per-CPU free page caches. only its CPU uses a cache's lock,
+// except for a CPU that has run dry and steals pages.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int count;
+} kcache[NCPU];
+
+static void kcache_drain(struct kcache *kc);
+static void buddy_free(uint64 pa, int order);
+
+// pa4: struct for page control, one per page from pagebase to
+// PHYSTOP. kinit() carves the array from the start of free memory.
+struct page *pages;
+uint64 pagebase;
+uint npages;
 struct page *page_lru_head;
 int num_free_pages;
 int num_lru_pages;
@@ -40,21 +77,120 @@ void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
 
   // pa4: initialize locks
   initlock(&swaplock, "swaplock");
   initlock(&lrulock, "lru");
   
-  freerange(end + PGSIZE, (void*)PHYSTOP);
+  // pa4: page structs for the pages after the kernel, including
+  // those that hold the array itself
+  pagebase = PGROUNDUP((uint64)end);
+  npages = (PHYSTOP - pagebase) / PGSIZE;
+  pages = (struct page*)pagebase;
+  memset(pages, 0, npages * sizeof(struct page));
+
+  kmem.start = PGROUNDUP(pagebase + npages * sizeof(struct page));
+  freerange((void*)kmem.start, (void*)PHYSTOP);
 }
 
+// pa4: the page struct of physical page pa
+struct page*
+pa2page(uint64 pa)
+{
+  if(pa < pagebase || pa >= PHYSTOP)
+    panic("pa2page");
+  return &pages[(pa - pagebase) / PGSIZE];
+}
+
+// give [pa_start, pa_end) to the buddy allocator, in the
+// largest aligned blocks that fit.
 void
 freerange(void *pa_start, void *pa_end)
 {
-  char *p;
-  p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  uint64 pa = PGROUNDUP((uint64)pa_start);
+  int order;
+
+  acquire(&kmem.lock);
+  while(pa + PGSIZE <= (uint64)pa_end){
+    for(order = MAXORDER; order > 0; order--)
+      if(pa % (PGSIZE << order) == 0 && pa + (PGSIZE << order) <= (uint64)pa_end)
+        break;
+    buddy_free(pa, order);
+    pa += PGSIZE << order;
+  }
+  release(&kmem.lock);
+}
+
+static void
+freelist_push(int order, struct run *r)
+{
+  r->prev = 0;
+  r->next = kmem.free[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[order] = r;
+  pa2page((uint64)r)->free = BLOCK_FREE | order;
+}
+
+static void
+freelist_remove(int order, struct run *r)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  pa2page((uint64)r)->free = 0;
+}
+
+// take a block of 2^order pages, splitting a larger one if
+// need be. returns 0 if there is none.
+// kmem.lock must be held.
+static void*
+buddy_alloc(int order)
+{
+  struct run *r;
+  int k;
+
+  for(k = order; k <= MAXORDER && kmem.free[k] == 0; k++)
+    ;
+  if(k > MAXORDER)
+    return 0;
+  r = kmem.free[k];
+  freelist_remove(k, r);
+
+  // return the upper halves to the smaller lists
+  while(k > order){
+    k--;
+    freelist_push(k, (struct run*)((char*)r + (PGSIZE << k)));
+  }
+  return r;
+}
+
+// free the block of 2^order pages at pa, merging it with its
+// buddy for as long as the buddy is free.
+// kmem.lock must be held.
+static void
+buddy_free(uint64 pa, int order)
+{
+  uint64 buddy;
+
+  if(pa2page(pa)->free & BLOCK_FREE)
+    panic("kfree: double free");
+
+  while(order < MAXORDER){
+    buddy = pa ^ ((uint64)PGSIZE << order);
+    if(buddy < kmem.start || buddy >= PHYSTOP ||
+       pa2page(buddy)->free != (BLOCK_FREE | order))
+      break;
+    freelist_remove(order, (struct run*)buddy);
+    pa &= ~((uint64)PGSIZE << order);
+    order++;
+  }
+  freelist_push(order, (struct run*)pa);
 }
 
 // Free the page of physical memory pointed at by pa,
@@ -65,20 +201,148 @@ void
 kfree(void *pa)
 {
   struct run *r;
+  struct kcache *kc;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(((uint64)pa % PGSIZE) != 0 || (uint64)pa < kmem.start || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
   r = (struct run*)pa;
+  push_off();
+  kc = &kcache[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  kc->count++;
+  if(kc->count >= KCACHE_HIGH)
+    kcache_drain(kc);
+  release(&kc->lock);
+  pop_off();
+}
+
+// give n pages from kc back to the buddy allocator.
+// kc->lock must be held.
+static void
+kcache_drain_n(struct kcache *kc, int n)
+{
+  struct run *r;
+
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  while(n-- > 0 && (r = kc->freelist) != 0){
+    kc->freelist = r->next;
+    kc->count--;
+    buddy_free((uint64)r, 0);
+  }
   release(&kmem.lock);
 }
 
+// move KCACHE_BATCH pages from kc to the buddy allocator.
+// kc->lock must be held.
+static void
+kcache_drain(struct kcache *kc)
+{
+  kcache_drain_n(kc, KCACHE_BATCH);
+}
+
+// empty every CPU's cache, so that its pages can merge into
+// larger blocks.
+static void
+kcache_flush(void)
+{
+  struct kcache *kc;
+
+  for(kc = kcache; kc < &kcache[NCPU]; kc++){
+    acquire(&kc->lock);
+    kcache_drain_n(kc, kc->count);
+    release(&kc->lock);
+  }
+}
+
+// take up to KCACHE_BATCH pages from the buddy allocator into kc.
+// kc->lock must be held.
+static void
+kcache_refill(struct kcache *kc)
+{
+  struct run *r;
+  int i;
+
+  acquire(&kmem.lock);
+  for(i = 0; i < KCACHE_BATCH && (r = buddy_alloc(0)) != 0; i++){
+    r->next = kc->freelist;
+    kc->freelist = r;
+    kc->count++;
+  }
+  release(&kmem.lock);
+}
+
+// take half of another CPU's cache, when this one and the buddy
+// allocator are both empty. returns one of the pages, or 0 if every
+// cache is empty too. the caller holds no kcache lock, so two
+// CPUs stealing from each other cannot deadlock.
+static struct run*
+kcache_steal(int self)
+{
+  struct kcache *kc, *victim;
+  struct run *first, *last;
+  int i, n;
+
+  for(victim = kcache; victim < &kcache[NCPU]; victim++){
+    if(victim == &kcache[self])
+      continue;
+    acquire(&victim->lock);
+    if(victim->count == 0){
+      release(&victim->lock);
+      continue;
+    }
+    n = (victim->count + 1) / 2;
+    first = last = victim->freelist;
+    for(i = 1; i < n; i++)
+      last = last->next;
+    victim->freelist = last->next;
+    victim->count -= n;
+    release(&victim->lock);
+
+    // keep the first page, cache the rest here
+    kc = &kcache[self];
+    acquire(&kc->lock);
+    last->next = kc->freelist;
+    kc->freelist = first->next;
+    kc->count += n - 1;
+    release(&kc->lock);
+    return first;
+  }
+  return 0;
+}
+
+// a free page from this CPU's cache, refilled from the buddy
+// allocator or other CPUs' caches if need be. 0 if there is none.
+static struct run*
+kcache_alloc(void)
+{
+  struct kcache *kc;
+  struct run *r;
+  int id;
+
+  push_off();
+  id = cpuid();
+  kc = &kcache[id];
+  acquire(&kc->lock);
+  if(kc->freelist == 0)
+    kcache_refill(kc);
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->count--;
+  }
+  release(&kc->lock);
+  if(r == 0)
+    r = kcache_steal(id);
+  pop_off();
+  return r;
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -90,13 +354,11 @@ kalloc(void)
   struct cpu *c = mycpu();
   int nested = c->noff;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  // pa4: swap out
+  r = kcache_alloc();
+  // pa4: swap out, once neither this CPU's cache, the buddy
+  // allocator nor the other caches have a page
   while(!r)
   {
-    release(&kmem.lock);
-
     // ensure that there are no additional locks held before swapping
     if(myproc() == 0 || nested > 0)
         return 0;
@@ -108,21 +370,67 @@ kalloc(void)
         printf("Kalloc: OOM\n");
         return 0;
     }
-    
-    acquire(&kmem.lock);
-    r = kmem.freelist;
+
+    r = kcache_alloc();
   }
-  
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
-  
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
 
+// Allocate 2^order physically contiguous pages, aligned to
+// their size. Order 0 is kalloc(). Larger blocks come only from
+// the buddy allocator, without swapping, since swapping out
+// single pages need not free a contiguous run; the per-CPU
+// caches are flushed once so that their pages can merge.
+// Returns 0 if the memory cannot be allocated.
+void *
+kalloc_order(int order)
+{
+  void *pa;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order > MAXORDER)
+    return 0;
+
+  acquire(&kmem.lock);
+  pa = buddy_alloc(order);
+  release(&kmem.lock);
+  if(pa == 0){
+    kcache_flush();
+    acquire(&kmem.lock);
+    pa = buddy_alloc(order);
+    release(&kmem.lock);
+  }
+
+  if(pa)
+    memset(pa, 5, PGSIZE << order); // fill with junk
+  return pa;
+}
+
+// Free 2^order pages returned by kalloc_order(order).
+void
+kfree_order(void *pa, int order)
+{
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order > MAXORDER ||
+     ((uint64)pa % (PGSIZE << order)) != 0 ||
+     (uint64)pa < kmem.start || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
+
+  acquire(&kmem.lock);
+  buddy_free((uint64)pa, order);
+  release(&kmem.lock);
+}
+
 // pa4: swapinit
 void
 swapinit()
@@ -189,23 +497,30 @@ free_swapslot(int slot)
 void
 lru_add_nolock(struct page *p)
 {
+    uint idx = p - pages;
+
+    // already on the list
+    if(p->flags & PG_LRU)
+        return;
+
     // if lru is empty
     if(page_lru_head == 0)
     {
         // the page will be the head
         page_lru_head = p;
-        p->next = p;
-        p->prev = p;
+        p->next = idx;
+        p->prev = idx;
     }
     else
     {
         // insert page at the tail
         // which is right before the head
-        p->next = page_lru_head;
+        p->next = page_lru_head - pages;
         p->prev = page_lru_head->prev;
-        page_lru_head->prev->next = p;
-        page_lru_head->prev = p;
+        pages[page_lru_head->prev].next = idx;
+        page_lru_head->prev = idx;
     }
+    p->flags |= PG_LRU;
 }
 
 // pa4: add page to lru
@@ -225,11 +540,11 @@ lru_remove(struct page *p)
     if(page_lru_head == 0)
         return;
 
-    if(p->next == 0 || p->prev == 0)
+    if((p->flags & PG_LRU) == 0)
         return;
 
     // if page is the only page in the lru
-    if(page_lru_head == p && p->next == p)
+    if(page_lru_head == p && &pages[p->next] == p)
     {
         // clear the linked list
         page_lru_head = 0;
@@ -237,15 +552,16 @@ lru_remove(struct page *p)
     else
     {
         // remove page from list
-        p->prev->next = p->next;
-        p->next->prev = p->prev;
+        pages[p->prev].next = p->next;
+        pages[p->next].prev = p->prev;
         if(page_lru_head == p)
-            page_lru_head = p->next;
+            page_lru_head = &pages[p->next];
     }
 
-    // clean up pointers
+    // clean up links
     p->next = 0;
     p->prev = 0;
+    p->flags &= ~PG_LRU;
 }
 
 
@@ -284,7 +600,7 @@ swap_out(void)
     while(1)
     {
         //retrieve pte of page
-        pte = walk(p->pagetable, (uint64)p->vaddr, 0);
+        pte = walk(p->pagetable, (uint64)p->vpn << PGSHIFT, 0);
 
         uint64 check = (pte) ? PTE2PA(*pte) : 0;
 
@@ -292,7 +608,7 @@ swap_out(void)
         if(pte == 0 || (*pte & PTE_V) == 0 || check < (uint64)end || check >= PHYSTOP)
         {
             struct page *np = p;
-            p = p->next;
+            p = &pages[p->next];
             // remove invalid page
             lru_remove(np);
             
@@ -313,7 +629,7 @@ swap_out(void)
             // clear the bit to give a second chance
             *pte &= ~PTE_A;
             // move on to next page
-            p = p->next;
+            p = &pages[p->next];
             // update the head
             page_lru_head = p;
         }
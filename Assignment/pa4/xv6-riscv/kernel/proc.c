@@ -437,6 +437,20 @@ wait(uint64 addr)
   }
 }
 
+// number of RUNNING and RUNNABLE processes, for the load
+// averages. read without locks; it is only a hint.
+int
+nr_running(void)
+{
+  struct proc *p;
+  int n = 0;
+
+  for(p = proc; p < &proc[NPROC]; p++)
+    if(p->state == RUNNABLE || p->state == RUNNING)
+      n++;
+  return n;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -451,6 +465,7 @@ scheduler(void)
   struct cpu *c = mycpu();
 
   c->proc = 0;
+  cpuacct(CPU_KERNEL);  // start charging this cpu's time
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
@@ -478,7 +493,9 @@ scheduler(void)
     if(found == 0) {
       // nothing to run; stop running on this core until an interrupt.
       intr_on();
+      cpuacct(CPU_IDLE);
       asm volatile("wfi");
+      cpuacct(CPU_KERNEL);
     }
   }
 }
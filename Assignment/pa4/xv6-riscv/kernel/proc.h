@@ -18,12 +18,18 @@ struct context {
   uint64 s11;
 };
 
+// what a cpu's time is charged to (cpustat.c).
+enum cpumode { CPU_KERNEL, CPU_USER, CPU_IDLE };
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int acctmode;               // enum cpumode this cpu is charging time to.
+  uint64 acctstart;           // r_time() acctmode was entered, or 0 before the first.
+  uint64 accttime[3];         // time CSR cycles spent in each enum cpumode.
 };
 
 extern struct cpu cpus[NCPU];
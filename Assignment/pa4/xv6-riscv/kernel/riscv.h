@@ -349,14 +349,20 @@ sfence_vma()
 typedef uint64 pte_t;
 typedef uint64 *pagetable_t; // 512 PTEs
 
-// pa4: page struct
+// pa4: page struct, one for each physical page from end to
+// PHYSTOP (kalloc.c's pages[], found with pa2page()).
+// the LRU links are indexes into pages[], to keep it small.
 struct page{
-	struct page *next;
-	struct page *prev;
-	pagetable_t  pagetable;
-	char *vaddr;
+	uint next;              // LRU list links
+	uint prev;
+	pagetable_t  pagetable; // user page table that maps it
+	uint vpn;               // user virtual page number it is mapped at
+	uchar flags;            // PG_LRU; lrulock
+	uchar free;             // for the buddy allocator; kmem.lock
 };
 
+#define PG_LRU 0x1 // on the LRU list
+
 
 
 #endif // __ASSEMBLER__
@@ -105,6 +105,7 @@ extern uint64 sys_close(void);
 extern uint64 sys_swapread(void);
 extern uint64 sys_swapwrite(void);
 extern uint64 sys_swapstat(void);
+extern uint64 sys_cpustat(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -133,6 +134,7 @@ static uint64 (*syscalls[])(void) = {
 [SYS_swapread]	sys_swapread,
 [SYS_swapwrite] sys_swapwrite,
 [SYS_swapstat] sys_swapstat,
+[SYS_cpustat]  sys_cpustat,
 };
 
 void
@@ -91,3 +91,14 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// copy per-CPU times and load averages (cpustat.h) to
+// the user address in the first argument.
+uint64
+sys_cpustat(void)
+{
+  uint64 addr;
+
+  argaddr(0, &addr);
+  return cpustat(addr);
+}
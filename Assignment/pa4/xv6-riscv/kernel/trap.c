@@ -11,8 +11,6 @@ uint ticks;
 
 extern char trampoline[], uservec[], userret[];
 
-extern struct page pages[];
-
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
@@ -47,6 +45,8 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  cpuacct(CPU_KERNEL);
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -136,9 +136,9 @@ usertrap(void)
                     free_swapslot(blk);
 
                     // add to lru list
-                    struct page *page = &pages[(uint64)mem / PGSIZE];
+                    struct page *page = pa2page((uint64)mem);
                     page->pagetable = p->pagetable;
-                    page->vaddr = (char*)va0;
+                    page->vpn = va0 >> PGSHIFT;
                     lru_add(page);
 
                     sfence_vma();
@@ -181,6 +181,8 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  cpuacct(CPU_USER);
+
   // send syscalls, interrupts, and exceptions to uservec in trampoline.S
   uint64 trampoline_uservec = TRAMPOLINE + (uservec - trampoline);
   w_stvec(trampoline_uservec);
@@ -255,6 +257,8 @@ clockintr()
     release(&tickslock);
   }
 
+  loadupdate();
+
   // ask for the next timer interrupt. this also clears
   // the interrupt request. 1000000 is about a tenth
   // of a second.
@@ -16,7 +16,6 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 extern char trampoline[]; // trampoline.S
 
 // pa4: pages list
-extern struct page pages[];
 extern struct spinlock lrulock;
 
 extern char end[];
@@ -146,9 +145,9 @@ walkaddr(pagetable_t pagetable, uint64 va)
         *pte = PA2PTE(mem) | flags;
 
         // add to LRU
-        struct page *p = &pages[(uint64)mem / PGSIZE];
+        struct page *p = pa2page((uint64)mem);
         p->pagetable = pagetable;
-        p->vaddr = (char*)va;
+        p->vpn = va >> PGSHIFT;
         lru_add(p);
 
         // flush TLB
@@ -210,10 +209,10 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
        && a != TRAPFRAME && a != TRAMPOLINE)
     {
         // retrieve the specified page of the physical address
-        struct page *p = &pages[pa / PGSIZE];
+        struct page *p = pa2page(pa);
         // save the page information and add to lru
         p->pagetable = pagetable;
-        p->vaddr = (char*)a;
+        p->vpn = a >> PGSHIFT;
         // add to lru list
         lru_add(p);
     }
@@ -268,7 +267,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
         {
             acquire(&lrulock);
             // remove from LRU
-            struct page *p = &pages[pa / PGSIZE];
+            struct page *p = pa2page(pa);
             lru_remove(p);
             release(&lrulock);
         }
@@ -434,9 +433,9 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
             *pte = PA2PTE(pa) | flags;
 
             // add parent to the LRU
-            struct page *p = &pages[pa / PGSIZE];
+            struct page *p = pa2page(pa);
             p->pagetable = old;
-            p->vaddr = (char*)i;
+            p->vpn = i >> PGSHIFT;
             lru_add(p);
         }
         else
@@ -1,4 +1,5 @@
 struct stat;
+struct cpustat;
 
 // system calls
 int fork(void);
@@ -26,6 +27,7 @@ int uptime(void);
 void swapread(const char*, int);
 void swapwrite(const char*, int);
 void swapstat(int*, int*);
+int cpustat(struct cpustat*);
 
 
 
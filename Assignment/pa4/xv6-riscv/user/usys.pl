@@ -40,4 +40,5 @@ entry("uptime");
 entry("swapread");
 entry("swapwrite");
 entry("swapstat");
+entry("cpustat");
 